@@ -0,0 +1,134 @@
+// AllocCheck：稳态转发不得有堆分配。
+// 主持端 16 个流双向持续传输（本地服务不停发送，同时注入 Steam 数据消息），预热后统计转发线程上的
+// operator new 次数，出现任何分配即失败。ALLOC_CHECK_ABORT=1 时在第一次分配处 abort，方便用调试器看调用栈。
+#include "tunnel_fixture.h"
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+using namespace tunnel_fixture;
+
+namespace
+{
+thread_local bool counting = false; // only the forwarding thread is checked
+thread_local uint64_t allocations = 0;
+thread_local uint64_t allocatedBytes = 0;
+bool abortOnAllocation = false;
+
+void *countedAllocate(std::size_t size)
+{
+    if (counting)
+    {
+        ++allocations;
+        allocatedBytes += size;
+        if (abortOnAllocation)
+        {
+            std::abort();
+        }
+    }
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+const int kStreams = 16;
+const int kBatch = 64;
+const int kWarmupRounds = 500;
+const int kRounds = 2000;
+
+// One receive batch spread over every stream, written out, then whatever the local services sent
+void runRound(HostFixture &host, std::array<FakeMessage, kBatch> &messages)
+{
+    releasedMessages = 0;
+    for (auto &msg : messages)
+    {
+        host.manager->handleTunnelMessage(take(msg));
+    }
+    host.manager->flushInbound();
+    while (releasedMessages < kBatch)
+    {
+        host.io.run_one();
+    }
+    // The local services never stop sending: poll() would not return
+    for (int i = 0; i < 4 * kStreams && host.io.poll_one(); ++i)
+    {
+    }
+}
+}
+
+void *operator new(std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+int main()
+{
+    HostFixture host(kStreams, true);
+    std::vector<char> payload(1200, 'x');
+    std::array<FakeMessage, kBatch> messages;
+    for (int i = 0; i < kBatch; ++i)
+    {
+        setPacket(messages[i], host.ids[i % kStreams], 0, payload.data(), payload.size());
+    }
+
+    for (int round = 0; round < kWarmupRounds; ++round)
+    {
+        runRound(host, messages);
+    }
+    MultiplexStats before = host.manager->getStats();
+    uint64_t sentBefore = host.sentBytes;
+
+    abortOnAllocation = std::getenv("ALLOC_CHECK_ABORT") != nullptr;
+    counting = true;
+    for (int round = 0; round < kRounds; ++round)
+    {
+        runRound(host, messages);
+    }
+    counting = false;
+
+    MultiplexStats after = host.manager->getStats();
+    uint64_t inbound = after.inboundMessages - before.inboundMessages;
+    uint64_t outbound = host.sentBytes - sentBefore;
+    std::cout << "[AllocCheck] " << kStreams << " 个流，写入本地 " << inbound << " 条消息（"
+              << inbound * payload.size() / 1024 << " KB），发往隧道 " << outbound / 1024 << " KB；堆分配 "
+              << allocations << " 次 / " << allocatedBytes << " 字节" << std::endl;
+    if (inbound == 0 || outbound == 0)
+    {
+        std::cout << "[AllocCheck] 失败：传输没有在两个方向上进行" << std::endl;
+        return 1;
+    }
+    if (allocations > 0)
+    {
+        std::cout << "[AllocCheck] 失败：稳态转发路径上有堆分配（ALLOC_CHECK_ABORT=1 可定位）" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+// IdleCheck：两端都空闲的流必须活过 idleTimeout，链路断开后才被回收。
+// 客户端与主持端两个 MultiplexManager 经 setPacketSink 直接互发隧道包，空闲超时缩短为 3s，
+// 主持端 1s 发 keepalive，客户端 2s：主持端总是先发，客户端每次都被刷新、自己从不发送。
+// 先空闲 8s，两端的流都应保留（客户端应答主持端的 keepalive）；再切断链路，流应在超时后被回收。
+// 再模拟不认识 keepalive 的旧版客户端（丢弃 type 4/6）：主持端最多只能发出一个探测包，流不被回收。
+#include "net/multiplex_manager.h"
+#include <iostream>
+
+namespace
+{
+const auto kIdleTimeout = std::chrono::seconds(3);
+const auto kHostKeepalive = std::chrono::seconds(1);
+const auto kClientKeepalive = std::chrono::seconds(2);
+const auto kIdlePeriod = kIdleTimeout * 2 + std::chrono::seconds(2);
+
+// A packet in flight over the fake link; Release() frees it like Steam would
+struct LinkMessage : ISteamNetworkingMessage
+{
+    std::vector<char> packet;
+};
+
+bool linkUp = true;
+bool legacyClient = false; // client build from before keepalives: types 4 and 6 are unknown to it
+int unknownAtClient = 0;   // packets such a client would log as "Unknown packet type"
+
+// Delivered on the next turn of the io loop, as from a separate receive batch
+void deliver(boost::asio::io_context &io, std::weak_ptr<MultiplexManager> to, bool toClient, const char *data, size_t len)
+{
+    if (!linkUp)
+    {
+        return;
+    }
+    uint32_t type = 0;
+    if (legacyClient && TunnelHeader::decode(data, len, type) && (type == 4 || type == 6))
+    {
+        // A legacy client neither understands nor sends them
+        unknownAtClient += toClient ? 1 : 0;
+        return;
+    }
+    auto *msg = new LinkMessage;
+    msg->packet.assign(data, data + len);
+    msg->m_pData = msg->packet.data();
+    msg->m_cbSize = static_cast<int>(msg->packet.size());
+    msg->m_pfnRelease = [](ISteamNetworkingMessage *m) { delete static_cast<LinkMessage *>(m); };
+    boost::asio::post(io, [to, msg]()
+    {
+        SteamMessagePtr packet(msg);
+        if (auto manager = to.lock())
+        {
+            manager->handleTunnelMessage(std::move(packet));
+            manager->flushInbound();
+        }
+    });
+}
+
+bool fail(const std::string &reason)
+{
+    std::cout << "[IdleCheck] 失败：" << reason << std::endl;
+    return false;
+}
+
+// Host and client managers over the fake link, with one idle stream between their local sockets
+struct Tunnel
+{
+    Tunnel()
+        : work(boost::asio::make_work_guard(io)),
+          service(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          app(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)), game(io)
+    {
+        // Host's local service: accepts and then stays silent
+        auto serviceSocket = std::make_shared<boost::asio::ip::tcp::socket>(io);
+        service.async_accept(*serviceSocket, [this, serviceSocket](const boost::system::error_code &ec)
+        {
+            if (!ec)
+            {
+                serviceSockets.push_back(serviceSocket);
+            }
+        });
+        ForwardTarget target;
+        ForwardTarget::parse("tcp:127.0.0.1:" + std::to_string(service.local_endpoint().port()), target);
+        hostTargets.store({target});
+
+        host = std::make_shared<MultiplexManager>(nullptr, 0, io, hostFlag, hostTargets);
+        client = std::make_shared<MultiplexManager>(nullptr, 0, io, clientFlag, clientTargets);
+        std::weak_ptr<MultiplexManager> hostRef = host;
+        std::weak_ptr<MultiplexManager> clientRef = client;
+        boost::asio::io_context &context = io;
+        host->setPacketSink([&context, clientRef](const char *data, size_t len) { deliver(context, clientRef, true, data, len); });
+        client->setPacketSink([&context, hostRef](const char *data, size_t len) { deliver(context, hostRef, false, data, len); });
+        host->setIdlePolicy(kIdleTimeout, kHostKeepalive);
+        client->setIdlePolicy(kIdleTimeout, kClientKeepalive);
+
+        // Client's local game connection: connected, then silent
+        game.connect(app.local_endpoint());
+        auto local = std::make_shared<StreamSocket>(io);
+        app.accept(*local);
+        id = client->addClient(local);
+    }
+
+    ~Tunnel()
+    {
+        host.reset();
+        client.reset();
+        io.poll();
+    }
+
+    boost::asio::io_context io;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+    boost::asio::ip::tcp::acceptor service;
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> serviceSockets;
+    ForwardTargetList hostTargets;
+    ForwardTargetList clientTargets;
+    bool hostFlag = true;
+    bool clientFlag = false;
+    std::shared_ptr<MultiplexManager> host;
+    std::shared_ptr<MultiplexManager> client;
+    boost::asio::ip::tcp::acceptor app;
+    boost::asio::ip::tcp::socket game;
+    std::string id;
+};
+
+bool run()
+{
+    Tunnel tunnel;
+    tunnel.io.run_for(std::chrono::milliseconds(500));
+    if (!tunnel.host->getClient(tunnel.id))
+    {
+        return fail("主持端没有打开流");
+    }
+
+    tunnel.io.run_for(kIdlePeriod);
+    MultiplexStats clientStats = tunnel.client->getStats();
+    MultiplexStats hostStats = tunnel.host->getStats();
+    std::cout << "[IdleCheck] 空闲 " << kIdlePeriod.count() << "s：keepalive 客户端 "
+              << clientStats.keepalivesSent << " / 主持端 " << hostStats.keepalivesSent << "，回收 "
+              << clientStats.reapedIdle << " / " << hostStats.reapedIdle << std::endl;
+    if (!tunnel.client->getClient(tunnel.id) || !tunnel.host->getClient(tunnel.id) || clientStats.reapedIdle + hostStats.reapedIdle > 0)
+    {
+        return fail("两端都空闲的流在 idleTimeout 后被回收");
+    }
+    if (hostStats.keepalivesSent == 0)
+    {
+        return fail("没有发送 keepalive");
+    }
+
+    // Peer gone: nothing answers any more
+    linkUp = false;
+    tunnel.io.run_for(kIdleTimeout + kClientKeepalive * 2);
+    if (tunnel.client->getClient(tunnel.id) || tunnel.host->getClient(tunnel.id))
+    {
+        return fail("链路断开后流没有被回收");
+    }
+    std::cout << "[IdleCheck] 链路断开后已回收" << std::endl;
+    return true;
+}
+
+bool runLegacy()
+{
+    linkUp = true;
+    legacyClient = true;
+    Tunnel tunnel;
+    tunnel.io.run_for(std::chrono::milliseconds(500) + kIdlePeriod);
+    MultiplexStats hostStats = tunnel.host->getStats();
+    std::cout << "[IdleCheck] 旧版客户端空闲 " << kIdlePeriod.count() << "s：主持端 keepalive " << hostStats.keepalivesSent
+              << "，客户端未知包 " << unknownAtClient << std::endl;
+    if (!tunnel.host->getClient(tunnel.id) || !tunnel.client->getClient(tunnel.id))
+    {
+        return fail("不应答 keepalive 的旧版对端的流被回收");
+    }
+    if (unknownAtClient > 1)
+    {
+        return fail("向旧版对端发送了多个 keepalive");
+    }
+    return true;
+}
+}
+
+int main()
+{
+    return run() && runLegacy() ? 0 : 1;
+}
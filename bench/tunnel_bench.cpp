@@ -0,0 +1,171 @@
+// 隧道热路径微基准：包头编解码、流表查找（1/8/64 线程争用）、异步操作的 handler 内存、64 条消息一批的分发，
+// 以及经 Asio 反应器的本机套接字往返（比较 epoll 与 io_uring 构建）。
+// 用 -DCONNECTTOOL_BENCHMARKS=ON 构建 TunnelBench；只需要 Steamworks 头文件，不连接 Steam。
+//
+// 查找与分发基准以主持端身份运行，环境见 tunnel_fixture.h。
+#include "tunnel_fixture.h"
+#include <benchmark/benchmark.h>
+#include <array>
+
+using namespace tunnel_fixture;
+
+namespace
+{
+const int kStreams = 64;
+const int kBatch = 64;
+
+// Host-side manager with kStreams local streams to a sink that discards everything
+HostFixture &fixture()
+{
+    static HostFixture instance(kStreams, false);
+    return instance;
+}
+}
+
+// sendTunnelPacket framing: header plus payload copied into the reused packet buffer
+static void BM_PacketEncode(benchmark::State &state)
+{
+    std::string id = streamId(1);
+    std::vector<char> payload(static_cast<size_t>(state.range(0)), 'x');
+    std::vector<char> packet(TunnelHeader::kSize + payload.size());
+    for (auto _ : state)
+    {
+        size_t size = TunnelHeader::write(packet.data(), id, 0, payload.data(), payload.size());
+        benchmark::DoNotOptimize(packet.data());
+        benchmark::DoNotOptimize(size);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PacketEncode)->Arg(64)->Arg(1400)->Arg(MultiplexManager::kReadBufferSize);
+
+// handleTunnelMessage / handleTunnelPacket: type and stream id out of a received packet
+static void BM_HeaderDecode(benchmark::State &state)
+{
+    std::vector<char> packet;
+    TunnelHeader::build(packet, streamId(1), 4, nullptr, 0);
+    for (auto _ : state)
+    {
+        uint32_t type = 0;
+        bool valid = TunnelHeader::decode(packet.data(), packet.size(), type);
+        std::string id(packet.data(), TunnelHeader::kIdLen);
+        benchmark::DoNotOptimize(valid);
+        benchmark::DoNotOptimize(type);
+        benchmark::DoNotOptimize(id);
+    }
+}
+BENCHMARK(BM_HeaderDecode);
+
+// getClient on a 64-stream table; every thread of the same run shares one manager
+static void BM_StreamLookup(benchmark::State &state)
+{
+    HostFixture &host = fixture();
+    size_t next = static_cast<size_t>(state.thread_index()) * 7;
+    for (auto _ : state)
+    {
+        auto socket = host.manager->getClient(host.ids[next++ % host.ids.size()]);
+        benchmark::DoNotOptimize(socket);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StreamLookup)->Threads(1)->Threads(8)->Threads(64)->UseRealTime();
+
+// Operation state of one read: the stream's handler memory (1) against the heap (0)
+static void BM_HandlerAllocate(benchmark::State &state)
+{
+    HandlerMemory memory;
+    bool reuse = state.range(0) != 0;
+    for (auto _ : state)
+    {
+        void *op = reuse ? memory.allocate(256) : ::operator new(256);
+        benchmark::DoNotOptimize(op);
+        if (reuse)
+        {
+            memory.deallocate(op);
+        }
+        else
+        {
+            ::operator delete(op);
+        }
+    }
+}
+BENCHMARK(BM_HandlerAllocate)->Arg(0)->Arg(1);
+
+// One receive batch: kBatch data messages over range(0) streams, gathered, written and released
+static void BM_DispatchBatch(benchmark::State &state)
+{
+    HostFixture &host = fixture();
+    int streams = static_cast<int>(state.range(0));
+    std::vector<char> payload(1024, 'x');
+    std::array<FakeMessage, kBatch> messages;
+    for (int i = 0; i < kBatch; ++i)
+    {
+        setPacket(messages[i], host.ids[i % streams], 0, payload.data(), payload.size());
+    }
+    for (auto _ : state)
+    {
+        releasedMessages = 0;
+        for (auto &msg : messages)
+        {
+            host.manager->handleTunnelMessage(take(msg));
+        }
+        host.manager->flushInbound();
+        while (releasedMessages < kBatch)
+        {
+            host.io.run_one();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    state.SetBytesProcessed(state.iterations() * kBatch * static_cast<int64_t>(payload.size()));
+}
+BENCHMARK(BM_DispatchBatch)->Arg(1)->Arg(8)->Arg(64);
+
+// Socket round trip through the Asio reactor: one gather write of range(0) 1 KB buffers
+// (64 = the tunnel's largest gather) over loopback TCP, read back in full on the other end.
+// Labelled with the backend, so epoll and io_uring builds (CONNECTTOOL_IO_URING) compare directly.
+static void BM_SocketRoundTrip(benchmark::State &state)
+{
+    using boost::asio::ip::tcp;
+    boost::asio::io_context io;
+    tcp::acceptor acceptor(io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket writer(io);
+    tcp::socket reader(io);
+    writer.connect(acceptor.local_endpoint());
+    acceptor.accept(reader);
+    writer.set_option(tcp::no_delay(true));
+
+    const size_t kChunk = 1024;
+    size_t chunks = static_cast<size_t>(state.range(0));
+    std::vector<char> payload(chunks * kChunk, 'x');
+    std::vector<char> received(payload.size());
+    std::vector<boost::asio::const_buffer> gather;
+    for (size_t i = 0; i < chunks; ++i)
+    {
+        gather.emplace_back(payload.data() + i * kChunk, kChunk);
+    }
+
+    for (auto _ : state)
+    {
+        int pending = 2;
+        bool failed = false;
+        auto done = [&](const boost::system::error_code &ec, size_t)
+        {
+            failed |= static_cast<bool>(ec);
+            --pending;
+        };
+        boost::asio::async_write(writer, gather, done);
+        boost::asio::async_read(reader, boost::asio::buffer(received), done);
+        while (pending > 0 && io.run_one() > 0)
+        {
+        }
+        if (failed)
+        {
+            state.SkipWithError("loopback socket I/O failed");
+            break;
+        }
+    }
+    state.SetLabel(asioBackendName());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(payload.size()));
+}
+BENCHMARK(BM_SocketRoundTrip)->Arg(1)->Arg(8)->Arg(64);
+
+BENCHMARK_MAIN();
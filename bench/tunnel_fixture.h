@@ -0,0 +1,138 @@
+#pragma once
+
+// TunnelBench 与 AllocCheck 共用的测试环境：主持端 MultiplexManager 加一组本机 TCP 流。
+// 流通过 type 5 打开包连接到本机监听端口，对端在后台线程读掉写出的数据，可选地持续发送数据；
+// 发往 Steam 的包经 setPacketSink 交给计数器，接收的 Steam 消息由 FakeMessage 伪造。
+#include "net/multiplex_manager.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+namespace tunnel_fixture
+{
+inline std::string streamId(int index)
+{
+    char id[TunnelHeader::kIdLen + 1];
+    std::snprintf(id, sizeof(id), "s%05u", static_cast<unsigned>(index) % 100000u);
+    return id;
+}
+
+// Received message as Steam would hand it over; Release() counts instead of freeing
+struct FakeMessage : ISteamNetworkingMessage
+{
+    std::vector<char> packet;
+};
+
+inline std::atomic<int> releasedMessages{0};
+
+inline void setPacket(FakeMessage &msg, const std::string &id, uint32_t type, const char *data, size_t len)
+{
+    TunnelHeader::build(msg.packet, id, type, data, len);
+    msg.m_pData = msg.packet.data();
+    msg.m_cbSize = static_cast<int>(msg.packet.size());
+    msg.m_pfnRelease = [](ISteamNetworkingMessage *) { ++releasedMessages; };
+}
+
+inline SteamMessagePtr take(FakeMessage &msg)
+{
+    return SteamMessagePtr(&msg);
+}
+
+class HostFixture
+{
+public:
+    // feed: the local services keep sending, so every stream also carries outbound data
+    HostFixture(int streams, bool feed)
+        : sentPackets(0), sentBytes(0),
+          acceptor_(sinkIo_, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          feed_(feed), feedBuffer_(64 * 1024, 'f'), isHost_(true)
+    {
+        ForwardTarget target;
+        ForwardTarget::parse("tcp:127.0.0.1:" + std::to_string(acceptor_.local_endpoint().port()), target);
+        targets_.store({target});
+        accept();
+        sinkThread_ = std::thread([this]() { sinkIo_.run(); });
+
+        manager = std::make_shared<MultiplexManager>(nullptr, 0, io, isHost_, targets_);
+        manager->setPacketSink([this](const char *, size_t len) {
+            ++sentPackets;
+            sentBytes += len;
+        });
+        // Keepalives an hour out: the wheel still ticks, but nothing cascades or expires during a
+        // run. Its slots get their storage the first time each one fills, which would otherwise
+        // show up as allocations until the wheel has turned once.
+        manager->setIdlePolicy(std::chrono::hours(2), std::chrono::hours(1));
+        for (int i = 0; i < streams; ++i)
+        {
+            ids.push_back(streamId(i));
+            uint32_t service = 0;
+            FakeMessage open;
+            setPacket(open, ids.back(), 5, reinterpret_cast<const char *>(&service), sizeof(service));
+            manager->handleTunnelMessage(take(open));
+        }
+    }
+
+    ~HostFixture()
+    {
+        manager.reset();
+        io.poll(); // Let cancelled operations drop their handlers
+        sinkIo_.stop();
+        sinkThread_.join();
+    }
+
+    boost::asio::io_context io;
+    std::shared_ptr<MultiplexManager> manager;
+    std::vector<std::string> ids;
+    uint64_t sentPackets; // packet sink, io thread only
+    uint64_t sentBytes;
+
+private:
+    void accept()
+    {
+        acceptor_.async_accept([this](const boost::system::error_code &ec, boost::asio::ip::tcp::socket socket)
+        {
+            if (ec)
+            {
+                return;
+            }
+            auto sink = std::make_shared<boost::asio::ip::tcp::socket>(std::move(socket));
+            drain(sink, std::make_shared<std::vector<char>>(256 * 1024));
+            if (feed_)
+            {
+                send(sink);
+            }
+            accept();
+        });
+    }
+
+    static void drain(std::shared_ptr<boost::asio::ip::tcp::socket> sink, std::shared_ptr<std::vector<char>> buffer)
+    {
+        sink->async_read_some(boost::asio::buffer(*buffer), [sink, buffer](const boost::system::error_code &ec, std::size_t)
+        {
+            if (!ec)
+            {
+                drain(sink, buffer);
+            }
+        });
+    }
+
+    void send(std::shared_ptr<boost::asio::ip::tcp::socket> sink)
+    {
+        boost::asio::async_write(*sink, boost::asio::buffer(feedBuffer_), [this, sink](const boost::system::error_code &ec, std::size_t)
+        {
+            if (!ec)
+            {
+                send(sink);
+            }
+        });
+    }
+
+    boost::asio::io_context sinkIo_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::thread sinkThread_;
+    bool feed_;
+    std::vector<char> feedBuffer_;
+    bool isHost_;
+    ForwardTargetList targets_;
+};
+}
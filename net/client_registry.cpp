@@ -0,0 +1,64 @@
+#include "client_registry.h"
+
+ClientRegistry::Handle ClientRegistry::add(std::shared_ptr<StreamSocket> socket)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t slot;
+    if (!freeSlots_.empty())
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(slots_.size());
+        slots_.push_back(Slot{0, 0});
+    }
+    slots_[slot].denseIndex = static_cast<uint32_t>(dense_.size());
+    Client client;
+    client.socket = std::move(socket);
+    client.slot = slot;
+    dense_.push_back(std::move(client));
+    return makeHandle(slot, slots_[slot].generation);
+}
+
+ClientRegistry::Client *ClientRegistry::find(Handle handle)
+{
+    uint32_t slot = static_cast<uint32_t>(handle);
+    uint32_t generation = static_cast<uint32_t>(handle >> 32);
+    if (slot >= slots_.size() || slots_[slot].generation != generation)
+    {
+        return nullptr;
+    }
+    return &dense_[slots_[slot].denseIndex];
+}
+
+void ClientRegistry::remove(Handle handle)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    removeLocked(handle);
+}
+
+void ClientRegistry::removeLocked(Handle handle)
+{
+    if (!find(handle))
+    {
+        return; // Already removed (stale handle)
+    }
+    uint32_t slot = static_cast<uint32_t>(handle);
+    uint32_t index = slots_[slot].denseIndex;
+    if (index != dense_.size() - 1)
+    {
+        dense_[index] = std::move(dense_.back());
+        slots_[dense_[index].slot].denseIndex = index;
+    }
+    dense_.pop_back();
+    ++slots_[slot].generation; // Invalidate outstanding handles
+    freeSlots_.push_back(slot);
+}
+
+size_t ClientRegistry::size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dense_.size();
+}
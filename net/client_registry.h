@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "stream_socket.h"
+
+// 本地 TCP 客户端登记表（slot map）：句柄 = 槽位下标 + 代数，删除为 O(1)（与末尾交换），
+// 遍历走连续数组。流关闭时由 MultiplexManager 的关闭回调删除。
+// 套接字的读写都归 MultiplexManager，这里只登记，不做任何 I/O。
+class ClientRegistry {
+public:
+    using Handle = uint64_t;
+
+    Handle add(std::shared_ptr<StreamSocket> socket);
+    void remove(Handle handle);
+    size_t size();
+
+private:
+    struct Client {
+        std::shared_ptr<StreamSocket> socket;
+        uint32_t slot;
+    };
+    struct Slot {
+        uint32_t denseIndex;
+        uint32_t generation;
+    };
+
+    Client* find(Handle handle); // requires mutex_
+    void removeLocked(Handle handle);
+
+    static Handle makeHandle(uint32_t slot, uint32_t generation) { return (uint64_t(generation) << 32) | slot; }
+
+    std::mutex mutex_;
+    std::vector<Client> dense_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> freeSlots_;
+};
@@ -0,0 +1,182 @@
+#include "forward_target.h"
+
+std::string ForwardTarget::toString() const
+{
+    switch (kind)
+    {
+    case Kind::Tcp:
+        return "tcp:" + host + ":" + std::to_string(port);
+    case Kind::Unix:
+        return "unix:" + path;
+    default:
+        return "-";
+    }
+}
+
+static bool parsePort(const std::string &text, int &port)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 5)
+    {
+        return false;
+    }
+    port = std::stoi(text);
+    return port > 0 && port <= 65535;
+}
+
+bool ForwardTarget::parse(const std::string &spec, ForwardTarget &out)
+{
+    ForwardTarget target;
+    if (spec.rfind("unix:", 0) == 0)
+    {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        target.kind = Kind::Unix;
+        target.path = spec.substr(5);
+        if (target.path.empty())
+        {
+            return false;
+        }
+#else
+        return false; // No AF_UNIX support in this build
+#endif
+    }
+    else
+    {
+        std::string rest = spec.rfind("tcp:", 0) == 0 ? spec.substr(4) : spec;
+        target.kind = Kind::Tcp;
+        target.host = "127.0.0.1";
+        size_t colon = rest.rfind(':');
+        if (colon != std::string::npos)
+        {
+            target.host = rest.substr(0, colon);
+            rest = rest.substr(colon + 1);
+            // [::1]:port
+            if (target.host.size() > 2 && target.host.front() == '[' && target.host.back() == ']')
+            {
+                target.host = target.host.substr(1, target.host.size() - 2);
+            }
+            if (target.host.empty())
+            {
+                return false;
+            }
+        }
+        if (!parsePort(rest, target.port))
+        {
+            return false;
+        }
+    }
+    out = target;
+    return true;
+}
+
+bool ForwardTarget::parseList(const std::string &specs, std::vector<ForwardTarget> &out)
+{
+    std::vector<ForwardTarget> targets;
+    size_t start = 0;
+    while (start <= specs.size())
+    {
+        size_t comma = specs.find(',', start);
+        if (comma == std::string::npos)
+        {
+            comma = specs.size();
+        }
+        ForwardTarget target;
+        if (!parse(specs.substr(start, comma - start), target))
+        {
+            return false;
+        }
+        targets.push_back(target);
+        start = comma + 1;
+    }
+    out = targets;
+    return true;
+}
+
+std::string ForwardTarget::describeList(const std::vector<ForwardTarget> &targets)
+{
+    std::string result;
+    for (const auto &target : targets)
+    {
+        if (!result.empty())
+        {
+            result += ",";
+        }
+        result += target.kind == Kind::Tcp ? std::to_string(target.port) : "unix";
+    }
+    return result;
+}
+
+ForwardTarget::Endpoints ForwardTarget::resolve(boost::asio::io_context &io_context) const
+{
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    if (kind == Kind::Unix)
+    {
+        return Endpoints{boost::asio::local::stream_protocol::endpoint(path)};
+    }
+#endif
+    if (kind != Kind::Tcp)
+    {
+        throw boost::system::system_error(boost::asio::error::invalid_argument);
+    }
+    boost::asio::ip::tcp::resolver resolver(io_context);
+    Endpoints endpoints;
+    for (const auto &entry : resolver.resolve(host, std::to_string(port)))
+    {
+        endpoints.push_back(entry.endpoint());
+    }
+    if (endpoints.empty())
+    {
+        throw boost::system::system_error(boost::asio::error::host_not_found);
+    }
+    return endpoints;
+}
+
+void ForwardTarget::connect(boost::asio::io_context &io_context, StreamSocket &socket) const
+{
+    boost::asio::connect(socket, resolve(io_context));
+    setNoDelay(socket); // Enable TCP NoDelay
+}
+
+void ForwardTarget::asyncConnect(boost::asio::io_context &io_context, std::shared_ptr<StreamSocket> socket,
+                                 std::function<void(const boost::system::error_code &)> handler) const
+{
+    auto connectAll = [socket, handler](const Endpoints &endpoints)
+    {
+        boost::asio::async_connect(*socket, endpoints, [socket, handler](const boost::system::error_code &ec,
+                                                                          const boost::asio::generic::stream_protocol::endpoint &)
+        {
+            if (!ec)
+            {
+                setNoDelay(*socket);
+            }
+            handler(ec);
+        });
+    };
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    if (kind == Kind::Unix)
+    {
+        connectAll(Endpoints{boost::asio::local::stream_protocol::endpoint(path)});
+        return;
+    }
+#endif
+    if (kind != Kind::Tcp)
+    {
+        boost::asio::post(io_context, [handler]() { handler(boost::asio::error::invalid_argument); });
+        return;
+    }
+    auto resolver = std::make_shared<boost::asio::ip::tcp::resolver>(io_context);
+    resolver->async_resolve(host, std::to_string(port), [resolver, connectAll, handler](const boost::system::error_code &ec,
+                                                                                        boost::asio::ip::tcp::resolver::results_type results)
+    {
+        Endpoints endpoints;
+        for (const auto &entry : results)
+        {
+            endpoints.push_back(entry.endpoint());
+        }
+        if (ec || endpoints.empty())
+        {
+            handler(ec ? ec : boost::asio::error::host_not_found);
+            return;
+        }
+        connectAll(endpoints);
+    });
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include "stream_socket.h"
+
+// 主持端转发目标：
+//   25565 / tcp:25565      -> TCP 127.0.0.1:25565
+//   tcp:192.168.1.5:25565  -> TCP 指定地址
+//   unix:/run/game.sock    -> Unix 域套接字
+// 多个端口映射用逗号分隔（如 25565,25575,8123），下标即服务编号
+struct ForwardTarget {
+    enum class Kind { None, Tcp, Unix };
+
+    Kind kind = Kind::None;
+    std::string host;
+    int port = 0;
+    std::string path;
+
+    bool isValid() const { return kind != Kind::None; }
+    std::string toString() const;
+
+    static bool parse(const std::string& spec, ForwardTarget& out);
+    static bool parseList(const std::string& specs, std::vector<ForwardTarget>& out);
+    // Lobby-visible summary ("25565,25575,unix"); leaves out hosts and paths
+    static std::string describeList(const std::vector<ForwardTarget>& targets);
+
+    // Every address the target resolves to, in resolver order (e.g. ::1 then 127.0.0.1 for
+    // localhost); connect through boost::asio::connect / async_connect so each one is tried.
+    using Endpoints = std::vector<boost::asio::generic::stream_protocol::endpoint>;
+
+    // Throws boost::system::system_error on failure; never returns an empty list
+    Endpoints resolve(boost::asio::io_context& io_context) const;
+    void connect(boost::asio::io_context& io_context, StreamSocket& socket) const;
+    // Resolves and connects without blocking the io thread; NoDelay is set on success
+    void asyncConnect(boost::asio::io_context& io_context, std::shared_ptr<StreamSocket> socket,
+                      std::function<void(const boost::system::error_code&)> handler) const;
+};
+
+// 当前的转发目标列表：主线程的 host 命令整体替换，io 线程读取不可变快照，
+// 替换时正在使用旧列表的读者继续持有旧快照，不会读到释放中的内存
+class ForwardTargetList {
+public:
+    using Snapshot = std::shared_ptr<const std::vector<ForwardTarget>>;
+
+    ForwardTargetList() : targets_(std::make_shared<const std::vector<ForwardTarget>>()) {}
+    ForwardTargetList(const ForwardTargetList&) = delete;
+    ForwardTargetList& operator=(const ForwardTargetList&) = delete;
+
+    Snapshot load() const { return std::atomic_load(&targets_); }
+    void store(std::vector<ForwardTarget> targets)
+    {
+        std::atomic_store(&targets_, Snapshot(std::make_shared<const std::vector<ForwardTarget>>(std::move(targets))));
+    }
+
+private:
+    Snapshot targets_;
+};
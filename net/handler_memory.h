@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 异步操作的处理器内存：每个流的读、写各持有一块，同一时刻只有一个操作在用，
+// 完成后下一次操作直接复用，稳态转发不再为 handler 走堆分配。
+// 块已被占用或 handler 超出大小时退回 operator new（AllocCheck 会把这种情况报出来）。
+class HandlerMemory {
+public:
+    HandlerMemory() : inUse_(false) {}
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* allocate(std::size_t size)
+    {
+        bool expected = false;
+        if (size <= sizeof(storage_) && inUse_.compare_exchange_strong(expected, true))
+        {
+            return &storage_;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* pointer)
+    {
+        if (pointer == &storage_)
+        {
+            inUse_ = false;
+            return;
+        }
+        ::operator delete(pointer);
+    }
+
+private:
+    // Completion handlers of a gather async_write (composed op + reactor op) fit with room to spare
+    typename std::aligned_storage<1024>::type storage_;
+    std::atomic<bool> inUse_; // allocated and freed on different threads for client-side streams
+};
+
+// Associated allocator that hands out a HandlerMemory block
+template <typename T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) : memory_(memory) {}
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory_(other.memory_) {}
+
+    T* allocate(std::size_t n) const { return static_cast<T*>(memory_.allocate(sizeof(T) * n)); }
+    void deallocate(T* pointer, std::size_t) const { memory_.deallocate(pointer); }
+
+    bool operator==(const HandlerAllocator& other) const noexcept { return &memory_ == &other.memory_; }
+    bool operator!=(const HandlerAllocator& other) const noexcept { return &memory_ != &other.memory_; }
+
+private:
+    template <typename> friend class HandlerAllocator;
+    HandlerMemory& memory_;
+};
+
+// Wraps a completion handler so Asio allocates its operation state from `memory`.
+// The handler must keep `memory` alive (e.g. capture the shared_ptr that owns it).
+template <typename Handler>
+class AllocHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    AllocHandler(HandlerMemory& memory, Handler handler) : memory_(memory), handler_(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(memory_); }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler_(std::forward<Args>(args)...);
+    }
+
+private:
+    HandlerMemory& memory_;
+    Handler handler_;
+};
+
+template <typename Handler>
+AllocHandler<typename std::decay<Handler>::type> makeAllocHandler(HandlerMemory& memory, Handler&& handler)
+{
+    return AllocHandler<typename std::decay<Handler>::type>(memory, std::forward<Handler>(handler));
+}
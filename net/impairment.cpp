@@ -0,0 +1,162 @@
+#include "impairment.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool Impairment::active() const
+{
+    return latencyMs > 0 || jitterMs > 0 || lossPercent > 0 || reorderPercent > 0 || bandwidthKBps > 0;
+}
+
+std::string Impairment::describe() const
+{
+    if (!active())
+    {
+        return "无";
+    }
+    std::ostringstream out;
+    out << "时延 +" << latencyMs << "ms";
+    if (jitterMs > 0)
+    {
+        out << " 抖动 ±" << jitterMs << "ms";
+    }
+    out << " 丢包 " << lossPercent << "% 乱序 " << reorderPercent << "%";
+    out << " 带宽 " << (bandwidthKBps > 0 ? std::to_string(bandwidthKBps) + " KB/s" : std::string("不限"));
+    return out.str();
+}
+
+bool Impairment::apply(const std::string &settings, std::string &error)
+{
+    Impairment next = *this;
+    std::istringstream tokens(settings);
+    std::string token;
+    while (tokens >> token)
+    {
+        if (token == "clear")
+        {
+            next = Impairment();
+            continue;
+        }
+        size_t eq = token.find('=');
+        std::string key = token.substr(0, eq);
+        double value = 0;
+        try
+        {
+            if (eq == std::string::npos)
+            {
+                throw std::invalid_argument(token);
+            }
+            value = std::stod(token.substr(eq + 1));
+        }
+        catch (const std::exception &)
+        {
+            error = token;
+            return false;
+        }
+        if (value < 0)
+        {
+            error = token;
+            return false;
+        }
+        if (key == "latency")
+        {
+            next.latencyMs = static_cast<int>(value);
+        }
+        else if (key == "jitter")
+        {
+            next.jitterMs = static_cast<int>(value);
+        }
+        else if (key == "loss")
+        {
+            next.lossPercent = static_cast<float>(std::min(value, 100.0));
+        }
+        else if (key == "reorder")
+        {
+            next.reorderPercent = static_cast<float>(std::min(value, 100.0));
+        }
+        else if (key == "bandwidth")
+        {
+            next.bandwidthKBps = static_cast<int>(value);
+        }
+        else
+        {
+            error = token;
+            return false;
+        }
+    }
+    *this = next;
+    return true;
+}
+
+bool ImpairmentScenario::loadFile(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::cerr << "[劣化] 无法打开场景文件 " << path << std::endl;
+        return false;
+    }
+    name_ = path;
+    seed_ = 1;
+    steps_.clear();
+    Impairment current;
+    std::string line;
+    int lineNumber = 0;
+    bool ok = true;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first))
+        {
+            continue;
+        }
+        std::string rest;
+        std::getline(fields >> std::ws, rest);
+        std::string error;
+        if (first.compare(0, 4, "seed") == 0)
+        {
+            try
+            {
+                seed_ = static_cast<uint32_t>(std::stoul(line.substr(line.find('=') + 1)));
+                continue;
+            }
+            catch (const std::exception &)
+            {
+                error = line;
+            }
+        }
+        else
+        {
+            double at = -1;
+            try
+            {
+                at = std::stod(first);
+            }
+            catch (const std::exception &)
+            {
+                error = first;
+            }
+            if (error.empty() && (at < 0 || (!steps_.empty() && at < steps_.back().atSeconds)))
+            {
+                error = first + "（时间须递增）";
+            }
+            if (error.empty() && current.apply(rest, error))
+            {
+                steps_.push_back(Step{at, current, rest});
+                continue;
+            }
+        }
+        std::cerr << "[劣化] " << path << ":" << lineNumber << " 无法识别：" << error << std::endl;
+        ok = false;
+    }
+    if (ok && steps_.empty())
+    {
+        std::cerr << "[劣化] 场景文件 " << path << " 没有任何步骤" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 链路劣化参数：用于在本机复现玩家实际遇到的中继路径（如 150ms、2% 丢包）。
+// 同一组参数同时作用于 Steam 连接（Fake* 配置项）和本地劣化代理。
+struct Impairment {
+    int latencyMs = 0;        // 额外往返时延，两个方向各加一半
+    int jitterMs = 0;         // 单向时延抖动 (±)
+    float lossPercent = 0;    // 每个方向的丢包率
+    float reorderPercent = 0; // 乱序（延后投递）比例
+    int bandwidthKBps = 0;    // 每个方向的带宽上限，0 = 不限
+
+    bool active() const;
+    std::string describe() const;
+
+    // Applies "latency=150 jitter=20 loss=2 reorder=1 bandwidth=1024" or "clear" on top of
+    // the current values; returns false and names the bad token in `error`
+    bool apply(const std::string& settings, std::string& error);
+};
+
+// 可脚本化的劣化场景，保证基准测试可复现。文件格式：
+//   seed = 42
+//   # 秒  设置
+//   0     latency=150 jitter=10 loss=2
+//   30    loss=5 bandwidth=512
+//   60    clear
+// 每一步在上一步的基础上修改；最后一步之后场景结束（保留最后的设置）。
+class ImpairmentScenario {
+public:
+    struct Step {
+        double atSeconds;
+        Impairment impairment; // cumulative settings in effect from this step on
+        std::string settings;  // as written, for the log
+    };
+
+    // Malformed lines are reported and make the load fail
+    bool loadFile(const std::string& path);
+
+    const std::string& name() const { return name_; }
+    uint32_t seed() const { return seed_; }
+    const std::vector<Step>& steps() const { return steps_; }
+
+private:
+    std::string name_;
+    uint32_t seed_ = 1;
+    std::vector<Step> steps_;
+};
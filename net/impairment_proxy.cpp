@@ -0,0 +1,252 @@
+#include "impairment_proxy.h"
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+// One direction of a proxied connection. Chunks are read as fast as they arrive, stamped
+// with a delivery time and written in order once due, so latency does not cap throughput.
+class ImpairmentProxy::Pipe : public std::enable_shared_from_this<ImpairmentProxy::Pipe>
+{
+public:
+    Pipe(std::shared_ptr<Link> link, int direction, std::shared_ptr<StreamSocket> from, std::shared_ptr<StreamSocket> to,
+         std::shared_ptr<void> connection)
+        : link_(std::move(link)), direction_(direction), from_(std::move(from)), to_(std::move(to)), connection_(std::move(connection)),
+          timer_(to_->get_executor()), queued_(0), reading_(false), writing_(false), eof_(false)
+    {
+    }
+
+    void start()
+    {
+        read();
+    }
+
+private:
+    struct Chunk
+    {
+        std::vector<char> data;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    static constexpr size_t kChunkSize = 16 * 1024;
+    static constexpr size_t kMaxQueued = 4 * 1024 * 1024; // then stop reading: TCP backpressure
+
+    void read()
+    {
+        if (reading_ || eof_ || queued_ >= kMaxQueued)
+        {
+            return;
+        }
+        reading_ = true;
+        auto buffer = std::make_shared<std::vector<char>>(kChunkSize);
+        auto self = shared_from_this();
+        from_->async_read_some(boost::asio::buffer(*buffer), [self, buffer](const boost::system::error_code &ec, std::size_t n)
+        {
+            self->reading_ = false;
+            if (ec)
+            {
+                self->eof_ = true;
+                self->flush();
+                return;
+            }
+            buffer->resize(n);
+            auto due = self->link_->deliveryTime(self->direction_, n);
+            // A byte stream cannot overtake itself: a delayed chunk holds back the ones behind it
+            if (!self->chunks_.empty())
+            {
+                due = std::max(due, self->chunks_.back().due);
+            }
+            self->chunks_.push_back(Chunk{std::move(*buffer), due});
+            self->queued_ += n;
+            self->link_->bytes += n;
+            self->flush();
+            self->read();
+        });
+    }
+
+    void flush()
+    {
+        if (writing_)
+        {
+            return;
+        }
+        if (chunks_.empty())
+        {
+            if (eof_)
+            {
+                // Pass the half-close on; the other direction may still be writing to from_.
+                // Both sockets are closed by the connection once both directions finish.
+                boost::system::error_code ignored;
+                to_->shutdown(boost::asio::socket_base::shutdown_send, ignored);
+            }
+            return;
+        }
+        auto now = std::chrono::steady_clock::now();
+        auto self = shared_from_this();
+        if (chunks_.front().due > now)
+        {
+            writing_ = true;
+            timer_.expires_at(chunks_.front().due);
+            timer_.async_wait([self](const boost::system::error_code &)
+            {
+                self->writing_ = false;
+                self->flush();
+            });
+            return;
+        }
+        writing_ = true;
+        boost::asio::async_write(*to_, boost::asio::buffer(chunks_.front().data), [self](const boost::system::error_code &ec, std::size_t)
+        {
+            self->writing_ = false;
+            self->queued_ -= self->chunks_.front().data.size();
+            self->chunks_.pop_front();
+            if (ec)
+            {
+                boost::system::error_code ignored;
+                self->from_->close(ignored);
+                self->to_->close(ignored);
+                self->chunks_.clear();
+                return;
+            }
+            self->flush();
+            self->read();
+        });
+    }
+
+    std::shared_ptr<Link> link_;
+    int direction_;
+    std::shared_ptr<StreamSocket> from_;
+    std::shared_ptr<StreamSocket> to_;
+    std::shared_ptr<void> connection_; // shared by both directions; closes the sockets when both finish
+    boost::asio::steady_timer timer_;
+    std::deque<Chunk> chunks_;
+    size_t queued_;
+    bool reading_;
+    bool writing_;
+    bool eof_;
+};
+
+std::chrono::steady_clock::time_point ImpairmentProxy::Link::deliveryTime(int direction, size_t bytes)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::uniform_real_distribution<double> percent(0.0, 100.0);
+    double delayMs = impairment.latencyMs / 2.0;
+    if (impairment.jitterMs > 0)
+    {
+        std::uniform_real_distribution<double> jitter(-impairment.jitterMs, impairment.jitterMs);
+        delayMs = std::max(0.0, delayMs + jitter(rng));
+    }
+    if (impairment.lossPercent > 0 && percent(rng) < impairment.lossPercent)
+    {
+        // Lost segment: delivered after a retransmission timeout (Linux floor 200ms)
+        delayMs += std::max(200, impairment.latencyMs);
+        ++lostChunks;
+    }
+    if (impairment.reorderPercent > 0 && percent(rng) < impairment.reorderPercent)
+    {
+        delayMs += std::max(impairment.jitterMs, 10);
+        ++reorderedChunks;
+    }
+    TokenBucket &bucket = buckets[direction];
+    bucket.setRate(static_cast<uint64_t>(impairment.bandwidthKBps) * 1024);
+    auto serialization = bucket.consume(bytes, now);
+    return now + serialization + std::chrono::microseconds(static_cast<int64_t>(delayMs * 1000));
+}
+
+ImpairmentProxy::ImpairmentProxy(boost::asio::io_context &io_context, unsigned short listenPort, const ForwardTarget &target, uint32_t seed)
+    : io_context_(io_context), listenPort_(listenPort), target_(target), acceptor_(io_context), link_(std::make_shared<Link>())
+{
+    link_->rng.seed(seed);
+}
+
+ImpairmentProxy::~ImpairmentProxy()
+{
+    stop();
+}
+
+bool ImpairmentProxy::start(std::string &error)
+{
+    try
+    {
+        boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), listenPort_);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen();
+    }
+    catch (const boost::system::system_error &e)
+    {
+        error = e.what();
+        return false;
+    }
+    accept();
+    return true;
+}
+
+void ImpairmentProxy::stop()
+{
+    boost::system::error_code ignored;
+    acceptor_.close(ignored);
+}
+
+void ImpairmentProxy::setImpairment(const Impairment &impairment)
+{
+    std::lock_guard<std::mutex> lock(link_->mutex);
+    link_->impairment = impairment;
+}
+
+void ImpairmentProxy::seed(uint32_t seed)
+{
+    std::lock_guard<std::mutex> lock(link_->mutex);
+    link_->rng.seed(seed);
+}
+
+ImpairmentProxyStats ImpairmentProxy::getStats() const
+{
+    return ImpairmentProxyStats{listenPort_, target_.toString(), link_->connections, link_->bytes, link_->lostChunks, link_->reorderedChunks};
+}
+
+void ImpairmentProxy::accept()
+{
+    auto tcpSocket = std::make_shared<boost::asio::ip::tcp::socket>(io_context_);
+    std::weak_ptr<ImpairmentProxy> weak = weak_from_this();
+    acceptor_.async_accept(*tcpSocket, [weak, tcpSocket](const boost::system::error_code &ec)
+    {
+        auto self = weak.lock();
+        if (!self || ec == boost::asio::error::operation_aborted)
+        {
+            return;
+        }
+        if (!ec)
+        {
+            auto client = std::make_shared<StreamSocket>(std::move(*tcpSocket));
+            setNoDelay(*client); // error_code overload: the peer may already have reset
+            auto upstream = std::make_shared<StreamSocket>(self->io_context_);
+            // Connect in the background: the io thread also carries every tunnel stream
+            auto link = self->link_;
+            std::string target = self->target_.toString();
+            self->target_.asyncConnect(self->io_context_, upstream, [link, client, upstream, target](const boost::system::error_code &ec)
+            {
+                if (ec)
+                {
+                    std::cerr << "[劣化] 代理无法连接 " << target << ": " << ec.message() << std::endl;
+                    boost::system::error_code ignored;
+                    client->close(ignored);
+                    return;
+                }
+                ++link->connections;
+                auto connection = std::shared_ptr<void>(nullptr, [link, client, upstream](void *)
+                {
+                    boost::system::error_code ignored;
+                    client->close(ignored);
+                    upstream->close(ignored);
+                    --link->connections;
+                });
+                std::make_shared<Pipe>(link, 0, client, upstream, connection)->start();
+                std::make_shared<Pipe>(link, 1, upstream, client, connection)->start();
+            });
+        }
+        self->accept();
+    });
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include "forward_target.h"
+#include "impairment.h"
+#include "stream_socket.h"
+#include "traffic_shaper.h"
+
+struct ImpairmentProxyStats {
+    unsigned short listenPort;
+    std::string target;
+    size_t connections;
+    uint64_t bytes;
+    uint64_t lostChunks;      // 按丢包率模拟重传延迟的数据块
+    uint64_t reorderedChunks;
+};
+
+// 本地劣化代理：在 127.0.0.1:listenPort 接受连接，转发到目标，并对两个方向施加
+// 时延/抖动/带宽上限。不经过 Steam，便于在单机上复现固定的网络条件。
+// TCP 字节流无法真正丢包或乱序：丢包按一次重传超时的额外延迟模拟，
+// 乱序按数据块延后投递模拟（同时造成队头阻塞），与真实 TCP 的表现一致。
+// 所有套接字都在同一个 io_context 线程上运行。
+class ImpairmentProxy : public std::enable_shared_from_this<ImpairmentProxy> {
+public:
+    ImpairmentProxy(boost::asio::io_context& io_context, unsigned short listenPort, const ForwardTarget& target, uint32_t seed);
+    ~ImpairmentProxy();
+
+    bool start(std::string& error);
+    void stop();
+
+    void setImpairment(const Impairment& impairment);
+    void seed(uint32_t seed); // restart the random sequence (scenario runs)
+    ImpairmentProxyStats getStats() const;
+
+private:
+    class Pipe;
+
+    // State shared with the pipes; they can outlive the proxy briefly
+    struct Link {
+        std::mutex mutex;
+        Impairment impairment;
+        std::mt19937 rng;
+        TokenBucket buckets[2]; // one per direction
+        std::atomic<size_t> connections{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> lostChunks{0};
+        std::atomic<uint64_t> reorderedChunks{0};
+
+        // When a chunk read now should be delivered (before ordering against earlier chunks)
+        std::chrono::steady_clock::time_point deliveryTime(int direction, size_t bytes);
+    };
+
+    void accept();
+
+    boost::asio::io_context& io_context_;
+    unsigned short listenPort_;
+    ForwardTarget target_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::shared_ptr<Link> link_;
+};
@@ -0,0 +1,226 @@
+#include "local_connection_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+LocalConnectionPool::LocalConnectionPool(boost::asio::io_context &io_context, ForwardTargetList &targets)
+    : io_context_(io_context), targets_(targets), timer_(io_context), enabled_(false),
+      hits_(0), misses_(0), recycled_(0) {}
+
+LocalConnectionPool::~LocalConnectionPool()
+{
+    timer_.cancel();
+    closeAll();
+}
+
+void LocalConnectionPool::closeAll()
+{
+    for (auto &service : services_)
+    {
+        for (auto &entry : service.idle)
+        {
+            boost::system::error_code ignored;
+            entry.socket->close(ignored);
+        }
+        service.idle.clear();
+    }
+}
+
+void LocalConnectionPool::setEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled_ == enabled)
+    {
+        return;
+    }
+    enabled_ = enabled;
+    if (!enabled_)
+    {
+        closeAll();
+        return; // maintain() stops on its next tick
+    }
+    std::weak_ptr<LocalConnectionPool> weak = weak_from_this();
+    boost::asio::post(io_context_, [weak]()
+    {
+        if (auto self = weak.lock())
+        {
+            self->maintain();
+        }
+    });
+}
+
+bool LocalConnectionPool::isAlive(StreamSocket &socket)
+{
+    // Peek without consuming: would_block means open and quiet, 0 bytes means the server closed it.
+    // A server banner stays in the kernel buffer for the stream's first read.
+    boost::system::error_code ec, ignored;
+    socket.non_blocking(true, ignored);
+    char probe;
+    size_t n = socket.receive(boost::asio::buffer(&probe, 1), StreamSocket::message_peek, ec);
+    socket.non_blocking(false, ignored);
+    if (ec == boost::asio::error::would_block)
+    {
+        return true;
+    }
+    return !ec && n > 0;
+}
+
+std::shared_ptr<StreamSocket> LocalConnectionPool::acquire(uint32_t service)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!enabled_ || service >= services_.size())
+    {
+        return nullptr;
+    }
+    Service &pool = services_[service];
+    ++pool.opensThisTick;
+    auto now = std::chrono::steady_clock::now();
+    while (!pool.idle.empty())
+    {
+        Idle entry = std::move(pool.idle.front());
+        pool.idle.pop_front();
+        if (now - entry.connectedAt < kMaxIdleAge && isAlive(*entry.socket))
+        {
+            ++hits_;
+            refill(service);
+            return entry.socket;
+        }
+        boost::system::error_code ignored;
+        entry.socket->close(ignored);
+        ++recycled_;
+    }
+    ++misses_;
+    refill(service);
+    return nullptr;
+}
+
+size_t LocalConnectionPool::targetSize(const Service &service)
+{
+    // Keep enough warm sockets for ~2s of opens at the recent rate, at least one
+    size_t target = static_cast<size_t>(std::ceil(service.opensPerSec * 2.0));
+    return std::min(std::max<size_t>(target, 1), kMaxIdle);
+}
+
+void LocalConnectionPool::refill(uint32_t service)
+{
+    ForwardTargetList::Snapshot targets = targets_.load();
+    if (!enabled_ || service >= targets->size() || service >= services_.size() || !(*targets)[service].isValid())
+    {
+        return;
+    }
+    Service &pool = services_[service];
+    size_t target = targetSize(pool);
+    if (pool.idle.size() + pool.connecting >= target)
+    {
+        return;
+    }
+    // Resolving and connecting both run asynchronously: a slow DNS lookup for a hostname target
+    // must not hold mutex_ or stall the io thread that carries every peer's tunnel I/O
+    const ForwardTarget &forward = (*targets)[service];
+    while (pool.idle.size() + pool.connecting < target)
+    {
+        ++pool.connecting;
+        auto socket = std::make_shared<StreamSocket>(io_context_);
+        std::weak_ptr<LocalConnectionPool> weak = weak_from_this();
+        forward.asyncConnect(io_context_, socket, [weak, socket, service](const boost::system::error_code &ec)
+        {
+            auto self = weak.lock();
+            if (!self)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(self->mutex_);
+            if (service >= self->services_.size())
+            {
+                return;
+            }
+            Service &pool = self->services_[service];
+            --pool.connecting;
+            if (ec || !self->enabled_)
+            {
+                return; // Not resolvable or not listening yet; next maintain() tick retries
+            }
+            pool.idle.push_back(Idle{socket, std::chrono::steady_clock::now()});
+        });
+    }
+}
+
+void LocalConnectionPool::maintain()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!enabled_)
+        {
+            return;
+        }
+        // Track mapping changes from 'host'; shrinking drops the pools of removed services
+        size_t serviceCount = targets_.load()->size();
+        while (services_.size() > serviceCount)
+        {
+            for (auto &entry : services_.back().idle)
+            {
+                boost::system::error_code ignored;
+                entry.socket->close(ignored);
+            }
+            services_.pop_back();
+        }
+        services_.resize(serviceCount);
+
+        auto now = std::chrono::steady_clock::now();
+        for (uint32_t service = 0; service < services_.size(); ++service)
+        {
+            Service &pool = services_[service];
+            pool.opensPerSec = pool.opensPerSec * 0.8 + static_cast<double>(pool.opensThisTick) * 0.2;
+            pool.opensThisTick = 0;
+
+            // Drop aged or dead sockets, then shrink to target (oldest first)
+            size_t target = targetSize(pool);
+            for (auto it = pool.idle.begin(); it != pool.idle.end();)
+            {
+                bool excess = pool.idle.size() > target;
+                if (excess || now - it->connectedAt >= kMaxIdleAge || !isAlive(*it->socket))
+                {
+                    boost::system::error_code ignored;
+                    it->socket->close(ignored);
+                    it = pool.idle.erase(it);
+                    if (!excess)
+                    {
+                        ++recycled_;
+                    }
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+            refill(service);
+        }
+    }
+
+    std::weak_ptr<LocalConnectionPool> weak = weak_from_this();
+    timer_.expires_after(std::chrono::seconds(1));
+    timer_.async_wait([weak](const boost::system::error_code &ec)
+    {
+        if (ec)
+        {
+            return;
+        }
+        if (auto self = weak.lock())
+        {
+            self->maintain();
+        }
+    });
+}
+
+ConnectionPoolStats LocalConnectionPool::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ConnectionPoolStats stats{enabled_, 0, 0, 0.0, hits_, misses_, recycled_};
+    for (const auto &service : services_)
+    {
+        stats.idle += service.idle.size();
+        stats.target += enabled_ ? targetSize(service) : 0;
+        stats.opensPerSec += service.opensPerSec;
+    }
+    return stats;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "forward_target.h"
+
+struct ConnectionPoolStats {
+    bool enabled;
+    size_t idle;
+    size_t target;
+    double opensPerSec;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t recycled; // 过期或已被服务端关闭而丢弃的预连接
+};
+
+// 主持端到本地服务的预连接池：提前建立好到转发目标（TCP 或 Unix 域套接字）的连接，
+// 新隧道流直接取用，把 connect 和游戏服务器 accept 的耗时移出登录关键路径。
+// 每个服务（端口映射）各自一组；池大小按该服务最近的开流速率自适应；
+// 取用前校验连接是否仍然存活，闲置过久的连接会被回收重建。
+class LocalConnectionPool : public std::enable_shared_from_this<LocalConnectionPool> {
+public:
+    LocalConnectionPool(boost::asio::io_context& io_context, ForwardTargetList& targets);
+    ~LocalConnectionPool();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled_; }
+
+    // Returns a live pre-connected socket, or nullptr when the caller should connect itself
+    std::shared_ptr<StreamSocket> acquire(uint32_t service);
+
+    ConnectionPoolStats getStats();
+
+private:
+    struct Idle {
+        std::shared_ptr<StreamSocket> socket;
+        std::chrono::steady_clock::time_point connectedAt;
+    };
+    struct Service {
+        std::deque<Idle> idle;
+        size_t connecting = 0;
+        uint64_t opensThisTick = 0;
+        double opensPerSec = 0.0; // EWMA over 1s ticks
+    };
+
+    static constexpr size_t kMaxIdle = 16;
+    static constexpr std::chrono::seconds kMaxIdleAge{20}; // 留在常见服务端空闲超时之内
+
+    static bool isAlive(StreamSocket& socket);
+    void maintain();
+    void refill(uint32_t service); // requires mutex_
+    static size_t targetSize(const Service& service);
+    void closeAll(); // requires mutex_
+
+    boost::asio::io_context& io_context_;
+    ForwardTargetList& targets_;
+    boost::asio::steady_timer timer_;
+    std::mutex mutex_;
+    bool enabled_;
+    std::vector<Service> services_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t recycled_;
+};
@@ -0,0 +1,42 @@
+#include "memory_budget.h"
+
+MemoryBudget::MemoryBudget()
+    : limit_(0), reserved_(0), buffered_(0), steamPending_(0), refusedOpens_(0), pausedReads_(0) {}
+
+bool MemoryBudget::admitStream(size_t reservation)
+{
+    size_t limit = limit_;
+    if (limit == 0 || used() + reservation <= limit)
+    {
+        return true;
+    }
+    ++refusedOpens_;
+    return false;
+}
+
+bool MemoryBudget::shouldPause() const
+{
+    size_t limit = limit_;
+    if (limit == 0 || used() < limit)
+    {
+        return false;
+    }
+    // Reservations alone never drain (e.g. after lowering the limit); pausing would stall for good
+    return buffered_ + steamPending_ > 0;
+}
+
+bool MemoryBudget::shouldPauseReceive() const
+{
+    size_t limit = limit_;
+    if (limit == 0 || inbound() < limit)
+    {
+        return false;
+    }
+    // Only buffered data drains by itself (into local sockets)
+    return buffered_ > 0;
+}
+
+MemoryStats MemoryBudget::getStats() const
+{
+    return MemoryStats{limit_, reserved_, buffered_, steamPending_, refusedOpens_, pausedReads_};
+}
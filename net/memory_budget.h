@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct MemoryStats {
+    size_t limit;          // 0 = 不限
+    size_t reserved;       // 每个流常驻的读缓冲
+    size_t buffered;       // 已收到、等待写入本地 socket 的数据
+    size_t steamPending;   // Steam 发送缓冲中尚未确认的数据（所有对端）
+    uint64_t refusedOpens; // 因超出预算拒绝的新流
+    uint64_t pausedReads;  // 因超出预算推迟的本地读取
+};
+
+// 全局内存预算：所有对端的 MultiplexManager 共享一份。
+// 超出预算时先拒绝新流、暂停本地读取，让已缓冲的数据写完，不丢弃任何数据。
+// Steam 接收只看入站部分（常驻缓冲 + 待写数据）：发送缓冲要靠收到对端的确认才能排空，不能因它停收。
+class MemoryBudget {
+public:
+    MemoryBudget();
+
+    void setLimit(size_t bytes) { limit_ = bytes; }
+    size_t limit() const { return limit_; }
+
+    // Fixed per-stream buffers, held for the stream's lifetime
+    void reserve(size_t bytes) { reserved_ += bytes; }
+    void unreserve(size_t bytes) { reserved_ -= bytes; }
+    // Data waiting for a local write
+    void add(size_t bytes) { buffered_ += bytes; }
+    void release(size_t bytes) { buffered_ -= bytes; }
+    // Refreshed by the poll loop from each connection's real-time status
+    void setSteamPending(size_t bytes) { steamPending_ = bytes; }
+
+    // A new stream fits if its reservation does; false is counted as a refusal
+    bool admitStream(size_t reservation);
+    // Over budget with buffered data that will drain: hold off reading more from local sockets
+    bool shouldPause() const;
+    // Inbound data alone is over budget: hold off receiving from Steam
+    bool shouldPauseReceive() const;
+    void recordPausedRead() { ++pausedReads_; }
+
+    MemoryStats getStats() const;
+
+private:
+    size_t inbound() const { return reserved_ + buffered_; }
+    size_t used() const { return inbound() + steamPending_; }
+
+    std::atomic<size_t> limit_;
+    std::atomic<size_t> reserved_;
+    std::atomic<size_t> buffered_;
+    std::atomic<size_t> steamPending_;
+    std::atomic<uint64_t> refusedOpens_;
+    std::atomic<uint64_t> pausedReads_;
+};
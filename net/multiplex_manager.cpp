@@ -2,31 +2,74 @@
 #include "nanoid/nanoid.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+
+namespace
+{
+// Ring queues grow (rarely, under backlog) instead of allocating per element like std::deque
+template <typename T, typename V>
+void pushRing(boost::circular_buffer<T> &ring, V &&value)
+{
+    if (ring.full())
+    {
+        ring.set_capacity(std::max<size_t>(16, ring.capacity() * 2));
+    }
+    ring.push_back(std::forward<V>(value));
+}
+}
 
 MultiplexManager::MultiplexManager(ISteamNetworkingSockets *steamInterface, HSteamNetConnection steamConn,
-                                   boost::asio::io_context &io_context, bool &isHost, int &localPort)
+                                   boost::asio::io_context &io_context, bool &isHost, ForwardTargetList &targets,
+                                   std::shared_ptr<LocalConnectionPool> connectionPool, std::shared_ptr<TrafficShaper> shaper,
+                                   std::shared_ptr<MemoryBudget> budget, std::shared_ptr<TrafficCapture> capture)
     : steamInterface_(steamInterface), steamConn_(steamConn),
-      io_context_(io_context), isHost_(isHost), localPort_(localPort) {}
+      io_context_(io_context), isHost_(isHost), targets_(targets), connectionPool_(std::move(connectionPool)),
+      shaper_(std::move(shaper)), budget_(std::move(budget)), capture_(std::move(capture)), peerSendsOpen_(false),
+      peerAcksKeepalive_(false), keepaliveProbed_(false),
+      idleWheel_(std::chrono::milliseconds(250), std::chrono::steady_clock::now()),
+      wheelTimer_(io_context), wheelTimerArmed_(false), nextTimerTag_(0),
+      idleTimeout_(std::chrono::seconds(120)), keepaliveInterval_(std::chrono::seconds(30)),
+      keepalivesSent_(0), reapedIdle_(0), reapedOrphaned_(0), maxStreams_(0), rejectedStreams_(0),
+      drainTimer_(io_context), drainTimerArmed_(false), inboundBytes_(0),
+      inboundMessages_(0), inboundWrites_(0), inboundBatches_(0) {}
 
 MultiplexManager::~MultiplexManager()
 {
     // Close all sockets
     std::lock_guard<std::mutex> lock(mapMutex_);
+    wheelTimer_.cancel();
+    drainTimer_.cancel();
+    if (budget_)
+    {
+        // Includes writes still in flight: their completions no longer reach us
+        budget_->release(inboundBytes_);
+        budget_->unreserve(clientMap_.size() * kReadBufferSize);
+    }
     for (auto &pair : clientMap_)
     {
-        pair.second->close();
+        pair.second.socket->close();
+        if (pair.second.onClose)
+        {
+            pair.second.onClose();
+        }
     }
     clientMap_.clear();
 }
 
-std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket)
+std::string MultiplexManager::addClient(std::shared_ptr<StreamSocket> socket, uint32_t service, std::function<void()> onClose)
 {
     std::string id;
     {
         std::lock_guard<std::mutex> lock(mapMutex_);
         id = nanoid::generate(6);
-        clientMap_[id] = socket;
+        insertStream(id, socket, service, std::move(onClose));
+    }
+    if (capture_)
+    {
+        capture_->record(CaptureRecord::Open, CaptureRecord::Outbound, id, service);
     }
+    // Stream open carries the service index; reliable ordering puts it ahead of any data
+    sendTunnelPacket(id, reinterpret_cast<const char *>(&service), sizeof(service), 5);
     startAsyncRead(id);
     std::cout << "Added client with id " << id << std::endl;
     return id;
@@ -34,130 +77,740 @@ std::string MultiplexManager::addClient(std::shared_ptr<tcp::socket> socket)
 
 void MultiplexManager::removeClient(const std::string &id)
 {
-    std::lock_guard<std::mutex> lock(mapMutex_);
-    auto it = clientMap_.find(id);
-    if (it != clientMap_.end())
+    std::function<void()> onClose;
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        auto it = clientMap_.find(id);
+        if (it != clientMap_.end())
+        {
+            it->second.socket->close();
+            onClose = std::move(it->second.onClose);
+            releaseStream(it->second);
+            clientMap_.erase(it);
+        }
+    }
+    if (capture_)
+    {
+        capture_->record(CaptureRecord::Close, CaptureRecord::Outbound, id, 0);
+    }
+    if (onClose)
     {
-        it->second->close();
-        clientMap_.erase(it);
+        onClose();
     }
 
     std::cout << "Removed client with id " << id << std::endl;
 }
 
-std::shared_ptr<tcp::socket> MultiplexManager::getClient(const std::string &id)
+std::shared_ptr<StreamSocket> MultiplexManager::getClient(const std::string &id)
 {
     std::lock_guard<std::mutex> lock(mapMutex_);
     auto it = clientMap_.find(id);
     if (it != clientMap_.end())
     {
-        return it->second;
+        return it->second.socket;
     }
     return nullptr;
 }
 
-void MultiplexManager::sendTunnelPacket(const std::string &id, const char *data, size_t len, int type)
+std::shared_ptr<StreamSocket> MultiplexManager::touchClient(const std::string &id)
 {
-    // Packet format: string id (6 chars + null), uint32_t type, then data if type==0
-    size_t idLen = id.size() + 1; // include null terminator
-    size_t packetSize = idLen + sizeof(uint32_t) + (type == 0 ? len : 0);
-    std::vector<char> packet(packetSize);
-    std::memcpy(&packet[0], id.c_str(), idLen);
-    uint32_t *pType = reinterpret_cast<uint32_t *>(&packet[idLen]);
-    *pType = type;
-    if (type == 0 && data)
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto it = clientMap_.find(id);
+    if (it == clientMap_.end())
     {
-        std::memcpy(&packet[idLen + sizeof(uint32_t)], data, len);
+        return nullptr;
     }
-    steamInterface_->SendMessageToConnection(steamConn_, packet.data(), packet.size(), k_nSteamNetworkingSend_Reliable, nullptr);
+    it->second.lastActivity = std::chrono::steady_clock::now();
+    it->second.keepaliveSent = false;
+    return it->second.socket;
 }
 
-void MultiplexManager::handleTunnelPacket(const char *data, size_t len)
+void MultiplexManager::insertStream(const std::string &id, std::shared_ptr<StreamSocket> socket, uint32_t service, std::function<void()> onClose)
 {
-    size_t idLen = 7; // 6 + null
-    if (len < idLen + sizeof(uint32_t))
+    auto now = std::chrono::steady_clock::now();
+    uint64_t tag = ++nextTimerTag_;
+    clientMap_[id] = Stream{socket, now, tag, false, std::move(onClose), service, TokenBucket(), std::make_shared<StreamBuffers>()};
+    if (budget_)
+    {
+        budget_->reserve(kReadBufferSize);
+    }
+    idleWheel_.schedule(id, tag, now + keepaliveInterval_);
+    armWheelTimer();
+}
+
+void MultiplexManager::setIdlePolicy(std::chrono::seconds idleTimeout, std::chrono::seconds keepaliveInterval)
+{
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    idleTimeout_ = idleTimeout;
+    keepaliveInterval_ = keepaliveInterval;
+}
+
+MultiplexStats MultiplexManager::getStats()
+{
+    MultiplexStats stats{0, keepalivesSent_, reapedIdle_, reapedOrphaned_, rejectedStreams_, 0, 1.0,
+                         inboundMessages_, inboundWrites_, inboundBatches_, 0, 0, 0};
+    SteamNetConnectionRealTimeStatus_t status;
+    if (!packetSink_ && steamInterface_->GetConnectionRealTimeStatus(steamConn_, &status, 0, nullptr) == k_EResultOK)
+    {
+        stats.steamPending = static_cast<size_t>(status.m_cbPendingReliable + status.m_cbPendingUnreliable + status.m_cbSentUnackedReliable);
+    }
+    std::lock_guard<std::mutex> sendLock(sendMutex_);
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    stats.activeStreams = clientMap_.size();
+    stats.queuedStreams = activeFlows_.size();
+    stats.memoryBytes = clientMap_.size() * kReadBufferSize + inboundBytes_;
+    for (const auto &pair : clientMap_)
+    {
+        stats.largestStream = std::max(stats.largestStream, kReadBufferSize + pair.second.inboundBytes + pair.second.writingBytes);
+    }
+
+    // Jain's index over streams that were competing: (sum x)^2 / (n * sum x^2), x = bytes / weight
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    size_t competing = 0;
+    for (auto it = flows_.begin(); it != flows_.end();)
+    {
+        Flow &flow = it->second;
+        if (flow.windowBacklogged)
+        {
+            double share = static_cast<double>(flow.windowBytes) / flow.weight;
+            sum += share;
+            sumSquares += share * share;
+            ++competing;
+        }
+        flow.windowBytes = 0;
+        flow.windowBacklogged = false;
+        if (!flow.active && clientMap_.find(it->first) == clientMap_.end())
+        {
+            it = flows_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    if (competing > 1 && sumSquares > 0)
+    {
+        stats.fairness = (sum * sum) / (competing * sumSquares);
+    }
+    return stats;
+}
+
+void MultiplexManager::setMaxStreams(size_t maxStreams)
+{
+    maxStreams_ = maxStreams;
+}
+
+bool MultiplexManager::canOpenStream()
+{
+    return !budget_ || budget_->admitStream(kReadBufferSize);
+}
+
+void MultiplexManager::armWheelTimer()
+{
+    if (wheelTimerArmed_)
     {
-        std::cerr << "Invalid tunnel packet size" << std::endl;
         return;
     }
-    std::string id(data, 6);
-    uint32_t type = *reinterpret_cast<const uint32_t *>(data + idLen);
-    if (type == 0)
+    wheelTimerArmed_ = true;
+    std::weak_ptr<MultiplexManager> weak = weak_from_this();
+    wheelTimer_.expires_after(idleWheel_.tick());
+    wheelTimer_.async_wait([weak](const boost::system::error_code &ec)
     {
-        // Data packet
-        size_t dataLen = len - idLen - sizeof(uint32_t);
-        const char *packetData = data + idLen + sizeof(uint32_t);
-        auto socket = getClient(id);
-        if (!socket && isHost_ && localPort_ > 0)
+        if (ec)
         {
-            // 如果是主持且没有对应的 TCP Client，创建一个连接到本地端口
-            std::cout << "Creating new TCP client for id " << id << " connecting to localhost:" << localPort_ << std::endl;
-            try
-            {
-                auto newSocket = std::make_shared<tcp::socket>(io_context_);
-                tcp::resolver resolver(io_context_);
-                auto endpoints = resolver.resolve("127.0.0.1", std::to_string(localPort_));
-                boost::asio::connect(*newSocket, endpoints);
-                newSocket->set_option(tcp::no_delay(true)); // Enable TCP NoDelay
+            return;
+        }
+        if (auto self = weak.lock())
+        {
+            self->onWheelTick();
+        }
+    });
+}
 
-                std::string tempId = id;
+void MultiplexManager::onWheelTick()
+{
+    // Runs every tick while streams are open: keep the per-tick lists' storage across ticks
+    thread_local std::vector<TimerWheel::Expired> expired;
+    thread_local std::vector<std::string> keepalives;
+    expired.clear();
+    keepalives.clear();
+    std::vector<std::string> reaped;
+    std::vector<std::function<void()>> closeHooks;
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        wheelTimerArmed_ = false;
+        auto now = std::chrono::steady_clock::now();
+        idleWheel_.advance(now, expired);
+        for (auto &entry : expired)
+        {
+            auto it = clientMap_.find(entry.key);
+            if (it == clientMap_.end() || it->second.timerTag != entry.tag)
+            {
+                continue; // Stream removed (or id reused) since it was scheduled
+            }
+            Stream &stream = it->second;
+            auto idle = now - stream.lastActivity;
+            // An older peer never answers keepalives: its silence says nothing, keep the stream
+            bool canReap = peerAcksKeepalive_;
+            if (idle >= idleTimeout_ && canReap)
+            {
+                stream.socket->close();
+                if (stream.onClose)
                 {
-                    std::lock_guard<std::mutex> lock(mapMutex_);
-                    clientMap_[id] = newSocket;
-                    socket = newSocket;
+                    closeHooks.push_back(std::move(stream.onClose));
                 }
-                std::cout << "Successfully created TCP client for id " << id << std::endl;
-                startAsyncRead(tempId);
+                releaseStream(stream);
+                clientMap_.erase(it);
+                reaped.push_back(entry.key);
+                ++reapedIdle_;
+                continue;
             }
-            catch (const std::exception &e)
+            auto next = stream.lastActivity + keepaliveInterval_;
+            // Before the peer has acked, one probe only: an older peer never answers and would
+            // log an unknown packet for every keepalive of every idle stream
+            if (idle >= keepaliveInterval_ && (canReap || !keepaliveProbed_))
             {
-                std::cerr << "Failed to create TCP client for id " << id << ": " << e.what() << std::endl;
-                return;
+                keepaliveProbed_ = true;
+                keepalives.push_back(entry.key);
+                stream.keepaliveSent = true;
+                next = canReap ? std::min(stream.lastActivity + idleTimeout_, now + keepaliveInterval_) : now + keepaliveInterval_;
             }
+            idleWheel_.schedule(entry.key, entry.tag, next);
+        }
+        if (!idleWheel_.empty())
+        {
+            armWheelTimer();
+        }
+    }
+
+    for (auto &hook : closeHooks)
+    {
+        hook();
+    }
+    for (const auto &id : reaped)
+    {
+        if (capture_)
+        {
+            capture_->record(CaptureRecord::Close, CaptureRecord::Outbound, id, 0);
+        }
+        std::cout << "Reaped idle client " << id << std::endl;
+        sendTunnelPacket(id, nullptr, 0, 1);
+    }
+    for (const auto &id : keepalives)
+    {
+        sendTunnelPacket(id, &kAnswersKeepalive, 1, 4);
+        ++keepalivesSent_;
+    }
+}
+
+void MultiplexManager::sendTunnelPacket(const std::string &id, const char *data, size_t len, int type)
+{
+    // Packet format: string id (6 chars + null), uint32_t type, then payload (data, service index, ping time).
+    // Built in a per-thread buffer that only grows: Steam copies the packet before returning.
+    thread_local std::vector<char> packet;
+    size_t needed = kHeaderLen + (data ? len : 0);
+    if (packet.size() < needed)
+    {
+        packet.resize(std::max(needed, kHeaderLen + kReadBufferSize));
+    }
+    size_t size = TunnelHeader::write(packet.data(), id, static_cast<uint32_t>(type), data, len);
+    if (packetSink_)
+    {
+        packetSink_(packet.data(), size);
+        return;
+    }
+    steamInterface_->SendMessageToConnection(steamConn_, packet.data(), static_cast<uint32>(size), k_nSteamNetworkingSend_Reliable, nullptr);
+}
+
+void MultiplexManager::handleTunnelMessage(SteamMessagePtr msg)
+{
+    const char *data = static_cast<const char *>(msg->m_pData);
+    size_t len = static_cast<size_t>(msg->m_cbSize);
+    uint32_t type;
+    if (!TunnelHeader::decode(data, len, type))
+    {
+        std::cerr << "Invalid tunnel packet size" << std::endl;
+        return;
+    }
+    if (type != 0)
+    {
+        handleTunnelPacket(data, len);
+        return; // msg released here
+    }
+
+    // Data packet: queue the message itself, the payload is written from m_pData
+    std::string id(data, TunnelHeader::kIdLen);
+    if (isHost_ && !peerSendsOpen_ && !getClient(id))
+    {
+        // Peers without stream-open packets: first data implies service 0
+        openLocalStream(id, 0);
+    }
+    size_t bytes = len - kHeaderLen;
+    if (capture_)
+    {
+        capture_->record(CaptureRecord::Data, CaptureRecord::Inbound, id, static_cast<uint32_t>(bytes), data + kHeaderLen);
+    }
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    auto it = clientMap_.find(id);
+    if (it == clientMap_.end())
+    {
+        std::cerr << "No client found for id " << id << std::endl;
+        return;
+    }
+    Stream &stream = it->second;
+    stream.lastActivity = std::chrono::steady_clock::now();
+    stream.keepaliveSent = false;
+    if (bytes == 0)
+    {
+        return;
+    }
+    if (stream.inbound.empty() && !stream.writing)
+    {
+        inboundDirty_.push_back(id);
+    }
+    pushRing(stream.inbound, std::move(msg));
+    stream.inboundBytes += bytes;
+    inboundBytes_ += bytes;
+    if (budget_)
+    {
+        budget_->add(bytes);
+    }
+}
+
+void MultiplexManager::flushInbound()
+{
+    std::lock_guard<std::mutex> lock(mapMutex_);
+    if (!inboundDirty_.empty())
+    {
+        ++inboundBatches_;
+    }
+    for (const auto &id : inboundDirty_)
+    {
+        auto it = clientMap_.find(id);
+        if (it != clientMap_.end() && !it->second.writing && !it->second.inbound.empty())
+        {
+            startInboundWrite(id, it->second);
         }
-        if (socket)
+    }
+    inboundDirty_.clear();
+}
+
+void MultiplexManager::startInboundWrite(const std::string &id, Stream &stream)
+{
+    // One gather write per stream: consecutive messages are written back to back from their
+    // Steam buffers, skipping each tunnel header. The batch owns the messages until completion.
+    std::shared_ptr<StreamBuffers> buffers = stream.buffers;
+    buffers->gather.clear();
+    size_t bytes = 0;
+    while (!stream.inbound.empty() && buffers->writing.size() < kMaxGather)
+    {
+        SteamMessagePtr &msg = stream.inbound.front();
+        size_t payload = static_cast<size_t>(msg->m_cbSize) - kHeaderLen;
+        buffers->gather.emplace_back(static_cast<const char *>(msg->m_pData) + kHeaderLen, payload);
+        bytes += payload;
+        buffers->writing.push_back(std::move(msg));
+        stream.inbound.pop_front();
+    }
+    stream.inboundBytes -= bytes;
+    stream.writingBytes = bytes;
+    stream.writing = true;
+    inboundMessages_ += buffers->writing.size();
+    ++inboundWrites_;
+
+    // Start the write on the socket's own thread so it never races the stream's reads.
+    // Both handlers live in the stream's write handler memory, one after the other. Posted
+    // through the io_context's executor: the socket's type-erased one ignores the handler's
+    // allocator and would allocate the posted function on every write.
+    std::shared_ptr<StreamSocket> socket = stream.socket;
+    std::weak_ptr<MultiplexManager> weak = weak_from_this();
+    auto &context = static_cast<boost::asio::io_context &>(socket->get_executor().context());
+    boost::asio::post(context.get_executor(), makeAllocHandler(buffers->writeHandler, [weak, id, socket, buffers, bytes]()
+    {
+        const boost::asio::const_buffer *gather = buffers->gather.data();
+        boost::asio::async_write(*socket, GatherView{gather, gather + buffers->gather.size()}, makeAllocHandler(buffers->writeHandler,
+            [weak, id, socket, buffers, bytes](const boost::system::error_code &ec, std::size_t)
         {
-            // Use synchronous write to prevent data interleaving
-            // Multiple async_write calls on the same socket can cause data corruption!
-            try {
-                boost::asio::write(*socket, boost::asio::buffer(packetData, dataLen));
-            } catch (const boost::system::system_error& e) {
-                std::cerr << "Error writing to TCP client " << id << ": " << e.what() << std::endl;
+            buffers->writing.clear(); // Release the Steam messages as soon as their bytes are out
+            if (auto self = weak.lock())
+            {
+                self->onInboundWritten(id, bytes, ec);
             }
+        }));
+    }));
+}
+
+void MultiplexManager::onInboundWritten(const std::string &id, size_t bytes, const boost::system::error_code &ec)
+{
+    inboundBytes_ -= bytes;
+    if (budget_)
+    {
+        budget_->release(bytes);
+    }
+    bool close = false;
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        auto it = clientMap_.find(id);
+        if (it == clientMap_.end())
+        {
+            return; // Removed while the write was in flight
+        }
+        Stream &stream = it->second;
+        stream.writing = false;
+        stream.writingBytes = 0;
+        if (ec)
+        {
+            close = true;
+        }
+        else if (!stream.inbound.empty())
+        {
+            startInboundWrite(id, stream);
         }
         else
         {
-            std::cerr << "No client found for id " << id << std::endl;
+            close = stream.closeAfterWrite;
         }
     }
-    else if (type == 1)
+    if (ec && ec != boost::asio::error::operation_aborted)
+    {
+        std::cerr << "Error writing to TCP client " << id << ": " << ec.message() << std::endl;
+    }
+    if (close)
+    {
+        removeClient(id);
+    }
+}
+
+void MultiplexManager::releaseStream(Stream &stream)
+{
+    // In-flight write bytes are returned when the write completes
+    inboundBytes_ -= stream.inboundBytes;
+    if (budget_)
+    {
+        budget_->release(stream.inboundBytes);
+        budget_->unreserve(kReadBufferSize);
+    }
+    stream.inboundBytes = 0;
+    stream.inbound.clear();
+}
+
+void MultiplexManager::handleTunnelPacket(const char *data, size_t len)
+{
+    uint32_t type;
+    if (!TunnelHeader::decode(data, len, type))
+    {
+        std::cerr << "Invalid tunnel packet size" << std::endl;
+        return;
+    }
+    std::string id(data, TunnelHeader::kIdLen);
+    if (type == 1)
     {
         // Disconnect packet
+        {
+            // A disconnect in answer to our keepalive means the peer had already lost the stream
+            std::lock_guard<std::mutex> lock(mapMutex_);
+            auto it = clientMap_.find(id);
+            if (it != clientMap_.end() && it->second.keepaliveSent)
+            {
+                ++reapedOrphaned_;
+                // The probe hit a stream the peer had already dropped: probe again on another
+                keepaliveProbed_ = false;
+            }
+            // Data sent before the disconnect is still being written: close after it
+            if (it != clientMap_.end() && (it->second.writing || !it->second.inbound.empty()))
+            {
+                it->second.closeAfterWrite = true;
+                return;
+            }
+        }
         removeClient(id);
         std::cout << "Client " << id << " disconnected" << std::endl;
     }
     else if (type == 2) // Ping
     {
         // Send Pong
-        sendTunnelPacket(id, data + idLen + sizeof(uint32_t), len - idLen - sizeof(uint32_t), 3);
+        sendTunnelPacket(id, data + kHeaderLen, len - kHeaderLen, 3);
     }
     else if (type == 3) // Pong
     {
+        if (len < kHeaderLen + sizeof(std::chrono::steady_clock::time_point))
+        {
+            return;
+        }
         auto now = std::chrono::steady_clock::now();
-        auto sentTime = *reinterpret_cast<const std::chrono::steady_clock::time_point*>(data + idLen + sizeof(uint32_t));
+        auto sentTime = *reinterpret_cast<const std::chrono::steady_clock::time_point*>(data + kHeaderLen);
         auto rtt = std::chrono::duration_cast<std::chrono::milliseconds>(now - sentTime).count();
         // std::cout << "[Ping] Pong received! RTT: " << rtt << " ms" << std::endl; // Silenced for performance
         std::cout << "RTT: " << rtt << " ms\r" << std::flush; // Print RTT in-place
     }
+    else if (type == 5) // Stream open
+    {
+        peerSendsOpen_ = true;
+        uint32_t service = 0;
+        if (len >= kHeaderLen + sizeof(uint32_t))
+        {
+            std::memcpy(&service, data + kHeaderLen, sizeof(service));
+        }
+        if (isHost_ && !getClient(id))
+        {
+            if (!openLocalStream(id, service))
+            {
+                sendTunnelPacket(id, nullptr, 0, 1); // Let the client close its side right away
+            }
+        }
+    }
+    else if (type == 4) // Stream keepalive
+    {
+        if (len > kHeaderLen && data[kHeaderLen] == kAnswersKeepalive)
+        {
+            peerAcksKeepalive_ = true;
+        }
+        if (touchClient(id))
+        {
+            // Our side of the stream may be just as idle: the answer refreshes the sender
+            sendTunnelPacket(id, nullptr, 0, 6);
+        }
+        else
+        {
+            // 对端仍持有该流而本地已不存在：通知对端关闭，避免半死连接残留
+            sendTunnelPacket(id, nullptr, 0, 1);
+        }
+    }
+    else if (type == 6) // Keepalive answer
+    {
+        peerAcksKeepalive_ = true;
+        touchClient(id);
+    }
     else
     {
         std::cerr << "Unknown packet type " << type << std::endl;
     }
 }
 
+std::shared_ptr<StreamSocket> MultiplexManager::openLocalStream(const std::string &id, uint32_t service)
+{
+    ForwardTargetList::Snapshot targets = targets_.load();
+    if (service >= targets->size() || !(*targets)[service].isValid())
+    {
+        std::cerr << "No local service " << service << " for id " << id << std::endl;
+        return nullptr;
+    }
+    size_t maxStreams = maxStreams_;
+    if (maxStreams > 0)
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        if (clientMap_.size() >= maxStreams)
+        {
+            ++rejectedStreams_;
+            std::cerr << "Stream limit (" << maxStreams << ") reached, refusing id " << id << std::endl;
+            return nullptr;
+        }
+    }
+    if (!canOpenStream())
+    {
+        std::cerr << "Memory budget exhausted, refusing id " << id << std::endl;
+        return nullptr;
+    }
+    const ForwardTarget &target = (*targets)[service];
+    // 如果是主持且没有对应的本地连接，创建一个连接到转发目标（优先取用预连接池）
+    std::cout << "Creating new local client for id " << id << " connecting to " << target.toString() << std::endl;
+    try
+    {
+        auto newSocket = connectionPool_ ? connectionPool_->acquire(service) : nullptr;
+        if (!newSocket)
+        {
+            newSocket = std::make_shared<StreamSocket>(io_context_);
+            target.connect(io_context_, *newSocket);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mapMutex_);
+            insertStream(id, newSocket, service);
+        }
+        if (capture_)
+        {
+            capture_->record(CaptureRecord::Open, CaptureRecord::Inbound, id, service);
+        }
+        std::cout << "Successfully created local client for id " << id << std::endl;
+        startAsyncRead(id);
+        return newSocket;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to create local client for id " << id << ": " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void MultiplexManager::resumeRead(const std::string &id, size_t bytesSent)
+{
+    auto delay = throttle(id, bytesSent);
+    if (delay <= std::chrono::steady_clock::duration::zero())
+    {
+        startAsyncRead(id);
+        return;
+    }
+    // Over the limit: stop reading for a while so the local sender backs off
+    scheduleRead(id, delay);
+}
+
+void MultiplexManager::scheduleRead(const std::string &id, std::chrono::steady_clock::duration delay)
+{
+    auto timer = std::make_shared<boost::asio::steady_timer>(io_context_);
+    std::weak_ptr<MultiplexManager> weak = weak_from_this();
+    timer->expires_after(delay);
+    timer->async_wait([weak, id, timer](const boost::system::error_code &ec)
+    {
+        auto self = weak.lock();
+        if (!ec && self)
+        {
+            self->startAsyncRead(id);
+        }
+    });
+}
+
+void MultiplexManager::enqueueOutbound(const std::string &id, std::shared_ptr<std::vector<char>> buffer, size_t len)
+{
+    if (capture_)
+    {
+        capture_->record(CaptureRecord::Data, CaptureRecord::Outbound, id, static_cast<uint32_t>(len), buffer->data());
+    }
+    uint32_t service = 0;
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        auto it = clientMap_.find(id);
+        if (it != clientMap_.end())
+        {
+            service = it->second.service;
+        }
+    }
+    uint32_t weight = shaper_ ? shaper_->serviceWeight(service) : 1;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        Flow &flow = flows_[id];
+        flow.buffer = std::move(buffer);
+        flow.len = len;
+        flow.service = service;
+        flow.weight = weight;
+        if (!flow.active)
+        {
+            flow.active = true;
+            flow.deficit = 0;
+            flow.quantumGranted = false;
+            pushRing(activeFlows_, id);
+        }
+    }
+    drainOutbound();
+}
+
+bool MultiplexManager::sendQueueFull() const
+{
+    SteamNetConnectionRealTimeStatus_t status;
+    if (packetSink_ || steamInterface_->GetConnectionRealTimeStatus(steamConn_, &status, 0, nullptr) != k_EResultOK)
+    {
+        return false;
+    }
+    return status.m_cbPendingReliable >= kSendHighWater;
+}
+
+void MultiplexManager::drainOutbound()
+{
+    // Per thread and reused; resumeRead never re-enters drainOutbound on the same thread
+    thread_local std::vector<std::pair<std::string, size_t>> sent;
+    sent.clear();
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        while (!activeFlows_.empty())
+        {
+            if (sendQueueFull())
+            {
+                for (const auto &id : activeFlows_)
+                {
+                    flows_[id].windowBacklogged = true;
+                }
+                if (!drainTimerArmed_)
+                {
+                    drainTimerArmed_ = true;
+                    std::weak_ptr<MultiplexManager> weak = weak_from_this();
+                    drainTimer_.expires_after(std::chrono::milliseconds(2));
+                    drainTimer_.async_wait([weak](const boost::system::error_code &ec)
+                    {
+                        auto self = weak.lock();
+                        if (!ec && self)
+                        {
+                            {
+                                std::lock_guard<std::mutex> lock(self->sendMutex_);
+                                self->drainTimerArmed_ = false;
+                            }
+                            self->drainOutbound();
+                        }
+                    });
+                }
+                break;
+            }
+            std::string id = activeFlows_.front();
+            activeFlows_.pop_front();
+            Flow &flow = flows_[id];
+            if (!flow.quantumGranted)
+            {
+                flow.deficit += kQuantum * flow.weight;
+                flow.quantumGranted = true;
+            }
+            if (flow.len > flow.deficit)
+            {
+                // Not enough credit this round; the quantum carries over
+                flow.quantumGranted = false;
+                flow.windowBacklogged = true;
+                pushRing(activeFlows_, id);
+                continue;
+            }
+            sendTunnelPacket(id, flow.buffer->data(), flow.len, 0);
+            sent.emplace_back(id, flow.len);
+            flow.windowBytes += flow.len;
+            flow.buffer.reset();
+            flow.len = 0;
+            flow.deficit = 0; // DRR: an emptied queue forfeits its remaining credit
+            flow.active = false;
+        }
+    }
+    for (const auto &entry : sent)
+    {
+        resumeRead(entry.first, entry.second);
+    }
+}
+
+std::chrono::steady_clock::duration MultiplexManager::throttle(const std::string &id, size_t bytes)
+{
+    if (!shaper_)
+    {
+        return std::chrono::steady_clock::duration::zero();
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto delay = std::chrono::steady_clock::duration::zero();
+    uint32_t service = 0;
+    {
+        std::lock_guard<std::mutex> lock(mapMutex_);
+        auto it = clientMap_.find(id);
+        if (it == clientMap_.end())
+        {
+            return delay;
+        }
+        service = it->second.service;
+        it->second.bucket.setRate(shaper_->streamRate());
+        delay = it->second.bucket.consume(bytes, now);
+        peerBucket_.setRate(shaper_->peerRate());
+        delay = std::max(delay, peerBucket_.consume(bytes, now));
+    }
+    delay = std::max(delay, shaper_->consumeService(service, bytes, now));
+    if (delay > std::chrono::steady_clock::duration::zero())
+    {
+        shaper_->recordThrottle(delay);
+    }
+    return delay;
+}
+
 void MultiplexManager::sendPing()
 {
-    std::string id = "PING"; // Dummy ID
+    std::string id = "PING__"; // Dummy ID (same 6-char length as stream ids)
     auto now = std::chrono::steady_clock::now();
     sendTunnelPacket(id, reinterpret_cast<const char*>(&now), sizeof(now), 2);
     // std::cout << "[Ping] Sending Ping..." << std::endl; // Silenced
@@ -165,51 +818,61 @@ void MultiplexManager::sendPing()
 
 void MultiplexManager::startAsyncRead(const std::string &id)
 {
-    std::shared_ptr<tcp::socket> socket;
+    std::shared_ptr<StreamSocket> socket;
+    std::shared_ptr<StreamBuffers> buffers;
     {
         std::lock_guard<std::mutex> lock(mapMutex_);
         auto it = clientMap_.find(id);
         if (it == clientMap_.end()) {
             return; // Client already removed
         }
-        socket = it->second;
+        socket = it->second.socket;
+        buffers = it->second.buffers;
     }
     
     if (!socket || !socket->is_open()) {
         return;
     }
+
+    if (budget_ && budget_->shouldPause())
+    {
+        // Over the memory budget: let buffered data drain before reading more
+        budget_->recordPausedRead();
+        scheduleRead(id, std::chrono::milliseconds(10));
+        return;
+    }
     
-    // Create a dedicated buffer for THIS async read operation
-    // This buffer is owned by the lambda and will not be invalidated by removeClient
-    auto readBuffer = std::make_shared<std::vector<char>>(131072); // 128KB
-    
-    // Capture socket and buffer by value (shared_ptr) to keep them alive
-    socket->async_read_some(boost::asio::buffer(*readBuffer),
-    [this, id, socket, readBuffer](const boost::system::error_code &ec, std::size_t bytes_transferred)
+    // The stream's read buffer: the next read starts only once the scheduler has sent this
+    // chunk, so one per stream is enough. The handler keeps it (and the socket) alive; the
+    // manager itself may be torn down (connection closed) before the read completes
+    std::weak_ptr<MultiplexManager> weak = weak_from_this();
+    socket->async_read_some(boost::asio::buffer(buffers->read), makeAllocHandler(buffers->readHandler,
+    [weak, id, socket, buffers](const boost::system::error_code &ec, std::size_t bytes_transferred)
     {
+        auto self = weak.lock();
+        if (!self)
+        {
+            return;
+        }
         if (!ec)
         {
             if (bytes_transferred > 0)
             {
                 // Check if client still exists before sending
-                bool clientExists = false;
-                {
-                    std::lock_guard<std::mutex> lock(mapMutex_);
-                    clientExists = (clientMap_.find(id) != clientMap_.end());
-                }
-                if (clientExists) {
-                    // readBuffer is owned by this lambda - it's safe to use
-                    sendTunnelPacket(id, readBuffer->data(), bytes_transferred, 0);
+                if (self->touchClient(id)) {
+                    // Aliasing handle: shares ownership of the stream's buffers without allocating
+                    self->enqueueOutbound(id, std::shared_ptr<std::vector<char>>(buffers, &buffers->read), bytes_transferred);
+                    return;
                 }
             }
-            startAsyncRead(id);
+            self->startAsyncRead(id);
         }
         else
         {
             if (ec != boost::asio::error::operation_aborted) {
                 std::cout << "Error reading from TCP client " << id << ": " << ec.message() << std::endl;
             }
-            removeClient(id);
+            self->removeClient(id);
         }
-    });
+    }));
 }
\ No newline at end of file
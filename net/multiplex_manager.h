@@ -5,37 +5,220 @@
 #include <mutex>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <boost/asio.hpp>
+#include <boost/circular_buffer.hpp>
 #include <steam_api.h>
 #include <isteamnetworkingsockets.h>
 #include <steamnetworkingtypes.h>
+#include "timer_wheel.h"
+#include "local_connection_pool.h"
+#include "traffic_shaper.h"
+#include "memory_budget.h"
+#include "traffic_capture.h"
+#include "forward_target.h"
+#include "stream_socket.h"
+#include "tunnel_packet.h"
+#include "handler_memory.h"
 
-using boost::asio::ip::tcp;
+struct MultiplexStats {
+    size_t activeStreams;
+    uint64_t keepalivesSent;
+    uint64_t reapedIdle;      // 空闲超时回收
+    uint64_t reapedOrphaned;  // 对端已不存在该流（keepalive 被拒）
+    uint64_t rejectedStreams; // 超出单个对端的流数上限
+    size_t queuedStreams;     // 正在等待发送配额的流
+    double fairness;          // 上次统计以来积压流按权重归一后的 Jain 公平指数 (1 = 完全公平)
+    uint64_t inboundMessages; // 写入本地套接字的数据消息
+    uint64_t inboundWrites;   // 实际发出的聚合写（每次一个 sendmsg）
+    uint64_t inboundBatches;  // 含数据的接收批次
+    size_t memoryBytes;       // 本对端占用：各流读缓冲 + 待写入本地的数据
+    size_t largestStream;     // 占用最多的单个流
+    size_t steamPending;      // 本对端在 Steam 发送缓冲中未确认的数据
+};
 
-class MultiplexManager {
+// Owning handle for a received Steam message; Release() runs when the handle goes away
+struct SteamMessageRelease {
+    void operator()(ISteamNetworkingMessage* msg) const { msg->Release(); }
+};
+using SteamMessagePtr = std::unique_ptr<ISteamNetworkingMessage, SteamMessageRelease>;
+
+class MultiplexManager : public std::enable_shared_from_this<MultiplexManager> {
 public:
+    static constexpr size_t kReadBufferSize = 128 * 1024; // one per stream, reserved in the budget
+
     MultiplexManager(ISteamNetworkingSockets* steamInterface, HSteamNetConnection steamConn, 
-                     boost::asio::io_context& io_context, bool& isHost, int& localPort);
+                     boost::asio::io_context& io_context, bool& isHost, ForwardTargetList& targets,
+                     std::shared_ptr<LocalConnectionPool> connectionPool = nullptr,
+                     std::shared_ptr<TrafficShaper> shaper = nullptr,
+                     std::shared_ptr<MemoryBudget> budget = nullptr,
+                     std::shared_ptr<TrafficCapture> capture = nullptr);
     ~MultiplexManager();
 
-    std::string addClient(std::shared_ptr<tcp::socket> socket);
+    // Opens a stream to the host's service `service` (index into its port mappings).
+    // onClose runs once when the stream is removed for any reason.
+    std::string addClient(std::shared_ptr<StreamSocket> socket, uint32_t service = 0, std::function<void()> onClose = nullptr);
     void removeClient(const std::string& id);
-    std::shared_ptr<tcp::socket> getClient(const std::string& id);
+    std::shared_ptr<StreamSocket> getClient(const std::string& id);
 
     void sendPing();
 
     void sendTunnelPacket(const std::string& id, const char* data, size_t len, int type);
 
-    void handleTunnelPacket(const char* data, size_t len);
+    // Receive path. Data payloads are written to the local socket straight from the Steam
+    // buffer; the message is released once its write completes. Call flushInbound() after
+    // a receive batch so each stream's queued messages go out in one gather write.
+    void handleTunnelMessage(SteamMessagePtr msg);
+    void flushInbound();
+    // Local writes are falling behind; the poll loop stops receiving on this connection
+    bool inboundBacklogged() const { return inboundBytes_ >= kInboundHighWater; }
+
+    // Streams with no traffic for keepaliveInterval get a keepalive, which the peer answers
+    // (type 6) while it still has the stream; streams without any traffic or answer for
+    // idleTimeout are reaped. Until the peer has shown it understands keepalives, only one
+    // probe is sent (older builds log each unknown packet) and its streams are not reaped.
+    void setIdlePolicy(std::chrono::seconds idleTimeout, std::chrono::seconds keepaliveInterval);
+    MultiplexStats getStats();
+    // Host side: refuse new streams from this peer beyond maxStreams (0 = unlimited)
+    void setMaxStreams(size_t maxStreams);
+    // Client side: check the memory budget before accepting a local connection
+    bool canOpenStream();
+
+    // Test hook: tunnel packets go to `sink` instead of the Steam connection, which is then
+    // never touched (benchmarks and allocation checks without a Steam runtime). Set before use.
+    using PacketSink = std::function<void(const char* data, size_t len)>;
+    void setPacketSink(PacketSink sink) { packetSink_ = std::move(sink); }
 
 private:
+    // Per-stream memory, allocated when the stream opens and reused by every read and write
+    // after that, so steady-state forwarding does no heap allocation. Shared with the handler
+    // of the operation in flight, which may outlive the stream and the manager.
+    // Non-owning buffer sequence over StreamBuffers::gather. async_write copies the sequence it
+    // is given; copying the vector itself would allocate on every write.
+    struct GatherView {
+        using value_type = boost::asio::const_buffer;
+        using const_iterator = const boost::asio::const_buffer *;
+
+        const_iterator begin() const { return first; }
+        const_iterator end() const { return last; }
+
+        const_iterator first;
+        const_iterator last;
+    };
+
+    struct StreamBuffers {
+        StreamBuffers() : read(kReadBufferSize)
+        {
+            writing.reserve(kMaxGather);
+            gather.reserve(kMaxGather);
+        }
+
+        std::vector<char> read;                         // one read in flight at a time
+        std::vector<SteamMessagePtr> writing;           // messages of the gather write in flight
+        std::vector<boost::asio::const_buffer> gather;  // their payloads
+        HandlerMemory readHandler;
+        HandlerMemory writeHandler;
+    };
+
+    struct Stream {
+        std::shared_ptr<StreamSocket> socket;
+        std::chrono::steady_clock::time_point lastActivity;
+        uint64_t timerTag;
+        bool keepaliveSent;
+        std::function<void()> onClose;
+        uint32_t service;
+        TokenBucket bucket; // per-stream shaping
+        std::shared_ptr<StreamBuffers> buffers;
+        // Received data waiting for the local write; payloads stay in the Steam buffers.
+        // Ring sized kMaxGather up front, grows only under backlog.
+        boost::circular_buffer<SteamMessagePtr> inbound = boost::circular_buffer<SteamMessagePtr>(kMaxGather);
+        size_t inboundBytes = 0;
+        size_t writingBytes = 0;
+        bool writing = false;         // a gather write is in flight
+        bool closeAfterWrite = false; // peer disconnected, close once inbound is written
+    };
+
     ISteamNetworkingSockets* steamInterface_;
     HSteamNetConnection steamConn_;
-    std::unordered_map<std::string, std::shared_ptr<tcp::socket>> clientMap_;
+    PacketSink packetSink_;
+    std::unordered_map<std::string, Stream> clientMap_;
     std::mutex mapMutex_;
     boost::asio::io_context& io_context_;
     bool& isHost_;
-    int& localPort_;
+    ForwardTargetList& targets_;
+    std::shared_ptr<LocalConnectionPool> connectionPool_;
+    std::shared_ptr<TrafficShaper> shaper_;
+    std::shared_ptr<MemoryBudget> budget_;
+    std::shared_ptr<TrafficCapture> capture_; // shared by all peers, records only while started
+    TokenBucket peerBucket_; // guarded by mapMutex_
+    std::atomic<bool> peerSendsOpen_; // peer announces streams with type 5 (service index)
+    std::atomic<bool> peerAcksKeepalive_; // peer answers keepalives with type 6, so silence means it is gone
+    bool keepaliveProbed_;                // a keepalive went out before the peer acked any; guarded by mapMutex_
+    static constexpr char kAnswersKeepalive = 1; // keepalive payload: the sender answers keepalives too
+
+    // Idle reaper / keepalive
+    TimerWheel idleWheel_;
+    boost::asio::steady_timer wheelTimer_;
+    bool wheelTimerArmed_;
+    uint64_t nextTimerTag_;
+    std::chrono::steady_clock::duration idleTimeout_;
+    std::chrono::steady_clock::duration keepaliveInterval_;
+    std::atomic<uint64_t> keepalivesSent_;
+    std::atomic<uint64_t> reapedIdle_;
+    std::atomic<uint64_t> reapedOrphaned_;
+
+    // Admission
+    std::atomic<size_t> maxStreams_;
+    std::atomic<uint64_t> rejectedStreams_;
+
+    // Outbound scheduler: deficit round robin over streams, one pending read per stream.
+    // Chunks are handed to Steam only while its reliable send queue is below the high-water
+    // mark, so when the link is saturated a small interactive chunk waits at most one round.
+    struct Flow {
+        std::shared_ptr<std::vector<char>> buffer;
+        size_t len = 0;
+        uint32_t service = 0;
+        uint32_t weight = 1;
+        size_t deficit = 0;
+        bool active = false;
+        bool quantumGranted = false;
+        uint64_t windowBytes = 0;       // sent since the last fairness sample
+        bool windowBacklogged = false;  // had to wait for its turn in this window
+    };
+    static constexpr size_t kQuantum = 16 * 1024;
+    static constexpr int kSendHighWater = 256 * 1024;
+    std::mutex sendMutex_;
+    std::unordered_map<std::string, Flow> flows_;
+    boost::circular_buffer<std::string> activeFlows_; // each flow at most once; grows with the stream count
+    boost::asio::steady_timer drainTimer_;
+    bool drainTimerArmed_;
+
+    // Inbound writes
+    static constexpr size_t kHeaderLen = TunnelHeader::kSize;
+    static constexpr size_t kMaxGather = 64;                    // messages per write (well under IOV_MAX)
+    static constexpr size_t kInboundHighWater = 4 * 1024 * 1024;
+    std::atomic<size_t> inboundBytes_; // queued or being written, all streams; mirrored in budget_
+    std::atomic<uint64_t> inboundMessages_;
+    std::atomic<uint64_t> inboundWrites_;
+    std::atomic<uint64_t> inboundBatches_;
+    std::vector<std::string> inboundDirty_; // streams that got data this batch; guarded by mapMutex_
 
+    void handleTunnelPacket(const char* data, size_t len); // control packets
     void startAsyncRead(const std::string& id);
+    void startInboundWrite(const std::string& id, Stream& stream); // requires mapMutex_
+    void onInboundWritten(const std::string& id, size_t bytes, const boost::system::error_code& ec);
+    void releaseStream(Stream& stream); // requires mapMutex_, before erasing the stream
+    std::chrono::steady_clock::duration throttle(const std::string& id, size_t bytes); // delay before next read
+    void enqueueOutbound(const std::string& id, std::shared_ptr<std::vector<char>> buffer, size_t len);
+    void drainOutbound();
+    bool sendQueueFull() const;
+    void resumeRead(const std::string& id, size_t bytesSent); // shaping, then the stream's next read
+    void scheduleRead(const std::string& id, std::chrono::steady_clock::duration delay);
+    void insertStream(const std::string& id, std::shared_ptr<StreamSocket> socket, uint32_t service, std::function<void()> onClose = nullptr); // requires mapMutex_
+    std::shared_ptr<StreamSocket> openLocalStream(const std::string& id, uint32_t service); // host side
+    std::shared_ptr<StreamSocket> touchClient(const std::string& id); // lookup + mark active
+    void armWheelTimer(); // requires mapMutex_
+    void onWheelTick();
 };
\ No newline at end of file
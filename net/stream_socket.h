@@ -0,0 +1,29 @@
+#pragma once
+
+#include <boost/asio.hpp>
+
+// 隧道本地端统一使用 generic 流套接字：TCP 与 Unix 域套接字走同一条异步路径
+using StreamSocket = boost::asio::generic::stream_protocol::socket;
+
+// TCP NoDelay; a no-op for non-TCP sockets
+inline void setNoDelay(StreamSocket& socket)
+{
+    boost::system::error_code ignored;
+    socket.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+}
+
+// Asio I/O backend compiled in (CONNECTTOOL_IO_URING selects io_uring on Linux)
+inline const char* asioBackendName()
+{
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    return "io_uring";
+#elif defined(BOOST_ASIO_HAS_IOCP)
+    return "IOCP";
+#elif defined(BOOST_ASIO_HAS_EPOLL)
+    return "epoll";
+#elif defined(BOOST_ASIO_HAS_KQUEUE)
+    return "kqueue";
+#else
+    return "select";
+#endif
+}
@@ -1,25 +1,44 @@
 #include "tcp_server.h"
 #include "../steam/steam_networking_manager.h"
+#include "thread_placement.h"
 #include <iostream>
 #include <algorithm>
 
-TCPServer::TCPServer(int port, SteamNetworkingManager* manager) : port_(port), running_(false), acceptor_(io_context_), work_(boost::asio::make_work_guard(io_context_)), manager_(manager) {}
+TCPServer::TCPServer(int port, SteamNetworkingManager* manager) : TCPServer(std::vector<int>{port}, manager) {}
+
+TCPServer::TCPServer(const std::vector<int>& ports, SteamNetworkingManager* manager, CSteamID hostID) : ports_(ports), running_(false), work_(boost::asio::make_work_guard(io_context_)), clients_(std::make_shared<ClientRegistry>()),
+    pendingTimer_(io_context_), pendingTimerArmed_(false), pendingCount_(0), pendingAttached_(0), pendingTimedOut_(0),
+    pendingRejected_(0), pendingWaitTotalMs_(0), pendingWaitMaxMs_(0), manager_(manager), hostID_(hostID) {}
 
 TCPServer::~TCPServer() { stop(); }
 
+HSteamNetConnection TCPServer::connection() const {
+    return hostID_.IsValid() ? manager_->getHostConnection(hostID_) : manager_->getConnection();
+}
+
 bool TCPServer::start() {
     try {
-        tcp::endpoint endpoint(tcp::v4(), port_);
-        acceptor_.open(endpoint.protocol());
-        acceptor_.set_option(tcp::acceptor::reuse_address(true));
-        acceptor_.bind(endpoint);
-        acceptor_.listen();
+        for (int port : ports_) {
+            tcp::endpoint endpoint(tcp::v4(), port);
+            auto acceptor = std::make_unique<tcp::acceptor>(io_context_);
+            acceptor->open(endpoint.protocol());
+            acceptor->set_option(tcp::acceptor::reuse_address(true));
+            acceptor->bind(endpoint);
+            acceptor->listen();
+            acceptors_.push_back(std::move(acceptor));
+        }
 
         running_ = true;
-        serverThread_ = std::thread([this]() { 
-            io_context_.run(); 
+        std::shared_ptr<ThreadPlacement> placement = manager_->getThreadPlacement();
+        std::string threadName = "tcp:" + std::to_string(ports_.front());
+        serverThread_ = std::thread([this, placement, threadName]() {
+            if (placement) placement->enter(ThreadPlacement::Network, threadName);
+            io_context_.run();
+            if (placement) placement->leave(threadName);
         });
-        start_accept();
+        for (uint32_t service = 0; service < acceptors_.size(); ++service) {
+            start_accept(service);
+        }
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Failed to start TCP server: " << e.what() << std::endl;
@@ -33,79 +52,148 @@ void TCPServer::stop() {
     if (serverThread_.joinable()) {
         serverThread_.join();
     }
-    acceptor_.close();
-}
-
-void TCPServer::sendToAll(const std::string& message, std::shared_ptr<tcp::socket> excludeSocket) {
-    sendToAll(message.c_str(), message.size(), excludeSocket);
-}
-
-void TCPServer::sendToAll(const char* data, size_t size, std::shared_ptr<tcp::socket> excludeSocket) {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    for (auto& client : clients_) {
-        if (client != excludeSocket) {
-            try {
-                boost::asio::write(*client, boost::asio::buffer(data, size));
-            } catch (const boost::system::system_error& e) {
-                // Ignore write errors, client may have disconnected
-            }
-        }
+    for (auto& acceptor : acceptors_) {
+        acceptor->close();
     }
 }
 
 int TCPServer::getClientCount() {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    return clients_.size();
+    return static_cast<int>(clients_->size());
 }
 
-void TCPServer::start_accept() {
-    auto socket = std::make_shared<tcp::socket>(io_context_);
-    acceptor_.async_accept(*socket, [this, socket](const boost::system::error_code& error) {
+PendingAcceptStats TCPServer::getPendingStats() {
+    return PendingAcceptStats{pendingCount_, pendingAttached_, pendingTimedOut_, pendingRejected_,
+                              pendingWaitTotalMs_, pendingWaitMaxMs_};
+}
+
+void TCPServer::start_accept(uint32_t service) {
+    auto socket = std::make_shared<StreamSocket>(io_context_);
+    acceptors_[service]->async_accept(*socket, [this, socket, service](const boost::system::error_code& error) {
         if (!error) {
             std::cout << "[TCP] 收到本地连接请求 (Minecraft?)" << std::endl;
             
-            if (!manager_->isConnected()) {
-                std::cout << "[TCP] 拒绝连接：未连接到主机 (P2P Not Ready)。" << std::endl;
-                socket->close();
-                if (running_) start_accept();
-                return;
+            setNoDelay(*socket); // Enable TCP NoDelay
+            if (manager_->isConnectionReady(connection()) && pending_.empty()) {
+                attach(socket, service, {});
+            } else {
+                queue_pending(socket, service);
             }
-
-            socket->set_option(tcp::no_delay(true)); // Enable TCP NoDelay
-            auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
-            std::string id = multiplexManager->addClient(socket);
-            {
-                std::lock_guard<std::mutex> lock(clientsMutex_);
-                clients_.push_back(socket);
-            }
-            // start_read(socket, id); // REMOVED: MultiplexManager handles reading. Preventing double-read race condition.
+            // MultiplexManager owns all reads and writes on the socket from here on
         }
         if (running_) {
-            start_accept();
+            start_accept(service);
         }
     });
 }
 
-void TCPServer::start_read(std::shared_ptr<tcp::socket> socket, std::string id) {
-    auto buffer = std::make_shared<std::vector<char>>(16384); // Increased buffer size
-    socket->async_read_some(boost::asio::buffer(*buffer), [this, socket, buffer, id](const boost::system::error_code& error, std::size_t bytes_transferred) {
-        if (!error) {
-            if (manager_->isConnected()) {
-                auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
-                multiplexManager->sendTunnelPacket(id, buffer->data(), bytes_transferred, 0);
+void TCPServer::attach(std::shared_ptr<StreamSocket> socket, uint32_t service, const std::vector<char>& earlyBytes) {
+    auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(connection());
+    if (!multiplexManager->canOpenStream()) {
+        std::cout << "[TCP] 内存预算已用尽，拒绝新的本地连接" << std::endl;
+        boost::system::error_code ignored;
+        socket->close(ignored);
+        return;
+    }
+    ClientRegistry::Handle handle = clients_->add(socket);
+    std::weak_ptr<ClientRegistry> registry = clients_;
+    std::string id = multiplexManager->addClient(socket, service, [registry, handle]() {
+        if (auto clients = registry.lock()) {
+            clients->remove(handle);
+        }
+    });
+    // The stream's first read completes on this same thread, so early bytes always go out first
+    if (!earlyBytes.empty()) {
+        multiplexManager->sendTunnelPacket(id, earlyBytes.data(), earlyBytes.size(), 0);
+    }
+}
+
+void TCPServer::queue_pending(std::shared_ptr<StreamSocket> socket, uint32_t service) {
+    if (pending_.size() >= kMaxPendingAccepts) {
+        std::cout << "[TCP] 拒绝连接：等待队列已满 (P2P Not Ready)。" << std::endl;
+        socket->close();
+        ++pendingRejected_;
+        return;
+    }
+    std::cout << "[TCP] P2P 尚未就绪，连接已进入等待队列。" << std::endl;
+    auto pending = std::make_shared<PendingAccept>();
+    pending->socket = socket;
+    pending->service = service;
+    pending->acceptedAt = std::chrono::steady_clock::now();
+    pending->readBuffer.resize(16384);
+    pending_.push_back(pending);
+    pendingCount_ = pending_.size();
+    read_pending(pending);
+    pump_pending();
+}
+
+void TCPServer::read_pending(std::shared_ptr<PendingAccept> pending) {
+    size_t room = kMaxEarlyBytes - pending->earlyBytes.size();
+    if (room == 0) {
+        return; // Leave the rest in the kernel buffer (TCP backpressure)
+    }
+    pending->reading = true;
+    auto buffer = boost::asio::buffer(pending->readBuffer.data(), std::min(room, pending->readBuffer.size()));
+    pending->socket->async_read_some(buffer, [this, pending](const boost::system::error_code& error, std::size_t bytes_transferred) {
+        pending->reading = false;
+        pending->earlyBytes.insert(pending->earlyBytes.end(), pending->readBuffer.begin(), pending->readBuffer.begin() + bytes_transferred);
+        if (pending->attachRequested) {
+            finish_pending(pending); // Read was cancelled by pump_pending
+            return;
+        }
+        if (error) {
+            pending->closed = true; // Client gave up while waiting
+            return;
+        }
+        read_pending(pending);
+    });
+}
+
+void TCPServer::finish_pending(std::shared_ptr<PendingAccept> pending) {
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - pending->acceptedAt).count();
+    pendingWaitTotalMs_ += waited;
+    if (static_cast<uint64_t>(waited) > pendingWaitMaxMs_) {
+        pendingWaitMaxMs_ = waited;
+    }
+    ++pendingAttached_;
+    std::cout << "[TCP] P2P 已就绪，接入等待中的连接（等待 " << waited << " ms，早期数据 " << pending->earlyBytes.size() << " 字节）。" << std::endl;
+    attach(pending->socket, pending->service, pending->earlyBytes);
+}
+
+void TCPServer::pump_pending() {
+    pendingTimerArmed_ = false;
+    auto now = std::chrono::steady_clock::now();
+    bool ready = manager_->isConnectionReady(connection());
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        auto pending = *it;
+        if (pending->closed) {
+            pending->socket->close();
+            it = pending_.erase(it);
+        } else if (ready) {
+            pending->attachRequested = true;
+            if (pending->reading) {
+                pending->socket->cancel(); // finish_pending runs from the read handler
+            } else {
+                finish_pending(pending);
             }
-            sendToAll(buffer->data(), bytes_transferred, socket);
-            start_read(socket, id);
+            it = pending_.erase(it);
+        } else if (now - pending->acceptedAt > kPendingTimeout) {
+            std::cout << "[TCP] 等待 P2P 超时，关闭本地连接。" << std::endl;
+            pending->socket->close();
+            ++pendingTimedOut_;
+            it = pending_.erase(it);
         } else {
-            // Send disconnect packet
-            if (manager_->isConnected()) {
-                auto multiplexManager = manager_->getMessageHandler()->getMultiplexManager(manager_->getConnection());
-                multiplexManager->sendTunnelPacket(id, nullptr, 0, 1);
-                // Remove client
-                multiplexManager->removeClient(id);
-            }
-            std::lock_guard<std::mutex> lock(clientsMutex_);
-            clients_.erase(std::remove(clients_.begin(), clients_.end(), socket), clients_.end());
+            ++it;
         }
-    });
+    }
+    pendingCount_ = pending_.size();
+
+    if (!pending_.empty() && !pendingTimerArmed_ && running_) {
+        pendingTimerArmed_ = true;
+        pendingTimer_.expires_after(std::chrono::milliseconds(20));
+        pendingTimer_.async_wait([this](const boost::system::error_code& error) {
+            if (!error) {
+                pump_pending();
+            }
+        });
+    }
 }
\ No newline at end of file
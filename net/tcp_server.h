@@ -5,40 +5,86 @@
 #include <vector>
 #include <string>
 #include <thread>
+#include <chrono>
+#include <atomic>
 #include <mutex>
 #include <unordered_map>
 #include <isteamnetworkingsockets.h>
 #include <isteamnetworkingutils.h>
 #include <steamnetworkingtypes.h>
 #include "multiplex_manager.h"
+#include "client_registry.h"
 
 class SteamNetworkingManager;
 
 using boost::asio::ip::tcp;
 
+struct PendingAcceptStats {
+    size_t queued;
+    uint64_t attached;
+    uint64_t timedOut;
+    uint64_t rejected;
+    uint64_t totalWaitMs; // summed over attached sockets
+    uint64_t maxWaitMs;
+};
+
 // TCP Server class
+// 每个端口映射一个监听端口：ports[i] 上接入的连接对应主机的第 i 个服务，共用同一条 P2P 连接
 class TCPServer {
 public:
     TCPServer(int port, SteamNetworkingManager* manager);
+    // hostID selects the host session this server tunnels to; nil means the primary connection
+    TCPServer(const std::vector<int>& ports, SteamNetworkingManager* manager, CSteamID hostID = CSteamID());
     ~TCPServer();
 
     bool start();
     void stop();
-    void sendToAll(const std::string& message, std::shared_ptr<tcp::socket> excludeSocket = nullptr);
-    void sendToAll(const char* data, size_t size, std::shared_ptr<tcp::socket> excludeSocket = nullptr);
     int getClientCount();
+    PendingAcceptStats getPendingStats();
+    const std::vector<int>& getPorts() const { return ports_; }
 
 private:
-    void start_accept();
-    void start_read(std::shared_ptr<tcp::socket> socket, std::string id);
+    void start_accept(uint32_t service);
+    HSteamNetConnection connection() const;
+
+    // P2P 尚未就绪时先挂起本地连接（并缓存其早期数据），连上后再接入 MultiplexManager，
+    // 省去游戏客户端被拒后自行重试的等待时间。以下成员只在 io_context_ 线程访问。
+    struct PendingAccept {
+        std::shared_ptr<StreamSocket> socket;
+        uint32_t service;
+        std::chrono::steady_clock::time_point acceptedAt;
+        std::vector<char> earlyBytes;
+        std::vector<char> readBuffer;
+        bool reading = false;
+        bool closed = false;
+        bool attachRequested = false;
+    };
+    static constexpr size_t kMaxPendingAccepts = 16;
+    static constexpr size_t kMaxEarlyBytes = 64 * 1024;
+    static constexpr std::chrono::seconds kPendingTimeout{20};
+
+    void attach(std::shared_ptr<StreamSocket> socket, uint32_t service, const std::vector<char>& earlyBytes);
+    void queue_pending(std::shared_ptr<StreamSocket> socket, uint32_t service);
+    void read_pending(std::shared_ptr<PendingAccept> pending);
+    void finish_pending(std::shared_ptr<PendingAccept> pending);
+    void pump_pending();
 
-    int port_;
+    std::vector<int> ports_;
     bool running_;
     boost::asio::io_context io_context_;
     boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_;
-    tcp::acceptor acceptor_;
-    std::vector<std::shared_ptr<tcp::socket>> clients_;
-    std::mutex clientsMutex_;
+    std::vector<std::unique_ptr<tcp::acceptor>> acceptors_;
+    std::shared_ptr<ClientRegistry> clients_;
+    std::vector<std::shared_ptr<PendingAccept>> pending_;
+    boost::asio::steady_timer pendingTimer_;
+    bool pendingTimerArmed_;
+    std::atomic<size_t> pendingCount_;
+    std::atomic<uint64_t> pendingAttached_;
+    std::atomic<uint64_t> pendingTimedOut_;
+    std::atomic<uint64_t> pendingRejected_;
+    std::atomic<uint64_t> pendingWaitTotalMs_;
+    std::atomic<uint64_t> pendingWaitMaxMs_;
     std::thread serverThread_;
     SteamNetworkingManager* manager_;
+    CSteamID hostID_;
 };
\ No newline at end of file
@@ -0,0 +1,415 @@
+#include "thread_placement.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+std::vector<int> processCpus()
+{
+    std::vector<int> cpus;
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    {
+        for (int cpu = 0; cpu < static_cast<int>(sizeof(DWORD_PTR) * 8); ++cpu)
+        {
+            if (processMask & (DWORD_PTR(1) << cpu))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus, std::vector<int> &effective, std::string &error)
+{
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+    {
+        mask |= DWORD_PTR(1) << cpu; // configure() only accepts CPUs of the process mask
+    }
+    if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0)
+    {
+        error = "SetThreadAffinityMask 错误 " + std::to_string(GetLastError());
+        return false;
+    }
+    effective = cpus;
+    return true;
+}
+
+bool raiseToRealtime(int, std::string &error)
+{
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+        error = "SetThreadPriority 错误 " + std::to_string(GetLastError());
+        return false;
+    }
+    return true;
+}
+
+bool setNice(int nice, std::string &error)
+{
+    int priority = nice <= -10 ? THREAD_PRIORITY_HIGHEST : nice < 0 ? THREAD_PRIORITY_ABOVE_NORMAL : THREAD_PRIORITY_BELOW_NORMAL;
+    if (!SetThreadPriority(GetCurrentThread(), priority))
+    {
+        error = "SetThreadPriority 错误 " + std::to_string(GetLastError());
+        return false;
+    }
+    return true;
+}
+
+std::string currentPriority()
+{
+    switch (GetThreadPriority(GetCurrentThread()))
+    {
+    case THREAD_PRIORITY_TIME_CRITICAL:
+        return "TIME_CRITICAL";
+    case THREAD_PRIORITY_HIGHEST:
+        return "HIGHEST";
+    case THREAD_PRIORITY_ABOVE_NORMAL:
+        return "ABOVE_NORMAL";
+    case THREAD_PRIORITY_BELOW_NORMAL:
+        return "BELOW_NORMAL";
+    case THREAD_PRIORITY_NORMAL:
+        return "普通";
+    default:
+        return "优先级 " + std::to_string(GetThreadPriority(GetCurrentThread()));
+    }
+}
+#elif defined(__linux__)
+std::vector<int> fromCpuSet(const cpu_set_t &set)
+{
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &set))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+std::vector<int> processCpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    {
+        return {};
+    }
+    return fromCpuSet(set);
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus, std::vector<int> &effective, std::string &error)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0)
+    {
+        error = std::strerror(rc);
+        return false;
+    }
+    // Read back: a cpuset cgroup can narrow what was asked for
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+    {
+        effective = fromCpuSet(set);
+    }
+    return true;
+}
+
+bool raiseToRealtime(int priority, std::string &error)
+{
+    sched_param param{};
+    param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO), std::min(priority, sched_get_priority_max(SCHED_FIFO)));
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (rc != 0)
+    {
+        error = rc == EPERM ? "无权限（需要 CAP_SYS_NICE 或 RLIMIT_RTPRIO）" : std::strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+bool setNice(int nice, std::string &error)
+{
+    // PRIO_PROCESS with a thread id sets that thread's nice only
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice) != 0)
+    {
+        error = errno == EACCES || errno == EPERM ? "无权限（需要 CAP_SYS_NICE 或 RLIMIT_NICE）" : std::strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+std::string currentPriority()
+{
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    if (policy == SCHED_FIFO || policy == SCHED_RR)
+    {
+        return (policy == SCHED_FIFO ? "FIFO " : "RR ") + std::to_string(param.sched_priority);
+    }
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)));
+    return errno == 0 && nice != 0 ? "nice " + std::to_string(nice) : std::string("普通");
+}
+#else
+std::vector<int> processCpus()
+{
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); ++cpu)
+    {
+        cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(const std::vector<int> &, std::vector<int> &, std::string &error)
+{
+    error = "此平台不支持绑核";
+    return false;
+}
+
+bool raiseToRealtime(int, std::string &error)
+{
+    error = "此平台不支持";
+    return false;
+}
+
+bool setNice(int, std::string &error)
+{
+    error = "此平台不支持";
+    return false;
+}
+
+std::string currentPriority()
+{
+    return "普通";
+}
+#endif
+}
+
+ThreadPlacement::ThreadPlacement() : allowedCpus_(processCpus()), nextNetworkCpu_(0) {}
+
+bool ThreadPlacement::parseCpuList(const std::string &text, std::vector<int> &cpus)
+{
+    std::vector<int> parsed;
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        std::string item = text.substr(start, end - start);
+        size_t dash = item.find('-');
+        std::string first = item.substr(0, dash);
+        std::string last = dash == std::string::npos ? first : item.substr(dash + 1);
+        auto isNumber = [](const std::string &s) { return !s.empty() && s.size() <= 4 && s.find_first_not_of("0123456789") == std::string::npos; };
+        if (!isNumber(first) || !isNumber(last))
+        {
+            return false;
+        }
+        int low = std::stoi(first);
+        int high = std::stoi(last);
+        if (low > high || high >= 1024)
+        {
+            return false;
+        }
+        for (int cpu = low; cpu <= high; ++cpu)
+        {
+            parsed.push_back(cpu);
+        }
+        start = end + 1;
+    }
+    std::sort(parsed.begin(), parsed.end());
+    parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+    cpus = parsed;
+    return true;
+}
+
+bool ThreadPlacement::parsePriority(const std::string &text, Config &config)
+{
+    std::string kind = text.substr(0, text.find(':'));
+    std::string value = text.find(':') == std::string::npos ? std::string() : text.substr(text.find(':') + 1);
+    int number = 0;
+    if (!value.empty())
+    {
+        size_t digits = value[0] == '-' ? 1 : 0;
+        if (value.size() == digits || value.size() > digits + 3 || value.find_first_not_of("0123456789", digits) != std::string::npos)
+        {
+            return false;
+        }
+        number = std::stoi(value);
+    }
+    if (kind == "normal" && value.empty())
+    {
+        config.fifoPriority = 0;
+        config.nice = 0;
+    }
+    else if (kind == "fifo" && (value.empty() || (number >= 1 && number <= 99)))
+    {
+        config.fifoPriority = value.empty() ? 10 : number;
+        config.nice = -10;
+    }
+    else if (kind == "nice" && !value.empty() && number >= -20 && number <= 19)
+    {
+        config.fifoPriority = 0;
+        config.nice = number;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+std::string ThreadPlacement::formatCpuList(const std::vector<int> &cpus)
+{
+    std::string text;
+    for (size_t i = 0; i < cpus.size();)
+    {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+        {
+            ++j;
+        }
+        text += (text.empty() ? "" : ",") + std::to_string(cpus[i]) + (j > i ? "-" + std::to_string(cpus[j]) : "");
+        i = j + 1;
+    }
+    return text.empty() ? "-" : text;
+}
+
+bool ThreadPlacement::configure(const Config &config, std::string &error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int cpu : config.networkCpus)
+    {
+        if (!allowedCpus_.empty() && !std::binary_search(allowedCpus_.begin(), allowedCpus_.end(), cpu))
+        {
+            error = "CPU " + std::to_string(cpu) + " 不在本进程可用的 CPU（" + formatCpuList(allowedCpus_) + "）中";
+            return false;
+        }
+    }
+    config_ = config;
+    nextNetworkCpu_ = 0;
+    return true;
+}
+
+ThreadPlacement::Config ThreadPlacement::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_;
+}
+
+std::vector<int> ThreadPlacement::controlCpus() const
+{
+    std::vector<int> cpus;
+    std::set_difference(allowedCpus_.begin(), allowedCpus_.end(), config_.networkCpus.begin(), config_.networkCpus.end(),
+                        std::back_inserter(cpus));
+    return cpus;
+}
+
+void ThreadPlacement::enter(Role role, const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<int> cpus;
+    std::string note;
+    if (!config_.networkCpus.empty())
+    {
+        if (role == Network)
+        {
+            // One CPU per network thread, round robin over the configured list
+            cpus.push_back(config_.networkCpus[nextNetworkCpu_++ % config_.networkCpus.size()]);
+        }
+        else
+        {
+            cpus = controlCpus();
+            if (cpus.empty())
+            {
+                note = "网络线程占用了全部 CPU，未绑核";
+            }
+        }
+    }
+
+    std::vector<int> effective = allowedCpus_;
+    std::string error;
+    if (!cpus.empty() && !pinCurrentThread(cpus, effective, error))
+    {
+        note = "绑核失败：" + error;
+    }
+    if (role == Network)
+    {
+        bool raised = false;
+        if (config_.fifoPriority > 0)
+        {
+            raised = raiseToRealtime(config_.fifoPriority, error);
+            if (!raised)
+            {
+                note += (note.empty() ? "" : "；") + std::string("SCHED_FIFO 未生效：") + error;
+            }
+        }
+        if (!raised && config_.nice != 0 && !setNice(config_.nice, error))
+        {
+            note += (note.empty() ? "" : "；") + std::string("nice ") + std::to_string(config_.nice) + " 未生效：" + error;
+        }
+    }
+
+    Placement placement{name, role, formatCpuList(effective), currentPriority() + (note.empty() ? "" : "（" + note + "）")};
+    if (!config_.networkCpus.empty() || (role == Network && (config_.fifoPriority > 0 || config_.nice != 0)))
+    {
+        std::cout << "[线程] " << name << "：CPU " << placement.cpus << "，" << placement.priority << std::endl;
+    }
+    auto it = std::find_if(placements_.begin(), placements_.end(), [&](const Placement &p) { return p.name == name; });
+    if (it != placements_.end())
+    {
+        *it = placement;
+    }
+    else
+    {
+        placements_.push_back(placement);
+    }
+}
+
+void ThreadPlacement::leave(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    placements_.erase(std::remove_if(placements_.begin(), placements_.end(), [&](const Placement &p) { return p.name == name; }),
+                      placements_.end());
+}
+
+std::string ThreadPlacement::summary() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string text = config_.networkCpus.empty() ? "未绑核" : "网络 CPU " + formatCpuList(config_.networkCpus);
+    for (const auto &placement : placements_)
+    {
+        text += " | " + placement.name + " CPU " + placement.cpus + " " + placement.priority;
+    }
+    return text;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 线程放置：网络线程（主 io 线程、各 TCPServer 线程）绑到指定 CPU 并提高调度优先级，
+// 输入线程与主循环（命令处理、状态监控）放到其余 CPU，减少共享主机上的迁移与抢占造成的延迟尖峰。
+// 每个线程启动时自己调用 enter()：Linux 上按线程设置 nice 只能作用于调用线程。
+// 权限不足时（SCHED_FIFO 需要 CAP_SYS_NICE 或 RLIMIT_RTPRIO）逐级退回，status 中显示实际生效的结果。
+class ThreadPlacement
+{
+public:
+    enum Role
+    {
+        Network, // pinned one CPU each, raised priority
+        Control  // kept off the network CPUs, normal priority
+    };
+
+    struct Config
+    {
+        std::vector<int> networkCpus; // empty = no pinning
+        int fifoPriority = 0;         // SCHED_FIFO priority for network threads, 0 = off
+        int nice = 0;                 // nice for network threads (fallback when SCHED_FIFO is denied), 0 = unchanged
+    };
+
+    // "2", "2,3", "2-5", "0,4-6"
+    static bool parseCpuList(const std::string &text, std::vector<int> &cpus);
+    // "fifo" / "fifo:N" (falls back to nice -10) / "nice:N" / "normal"
+    static bool parsePriority(const std::string &text, Config &config);
+    static std::string formatCpuList(const std::vector<int> &cpus);
+
+    ThreadPlacement();
+
+    // Applies to threads that enter() afterwards. Returns false (and keeps the old config)
+    // when a CPU is outside the process's allowed set.
+    bool configure(const Config &config, std::string &error);
+    Config getConfig() const;
+
+    // Place the calling thread and record what actually took effect under `name`
+    void enter(Role role, const std::string &name);
+    void leave(const std::string &name);
+
+    std::string summary() const;
+
+private:
+    struct Placement
+    {
+        std::string name;
+        Role role;
+        std::string cpus;     // effective affinity
+        std::string priority; // effective policy, plus why it differs from the request
+    };
+
+    std::vector<int> controlCpus() const; // requires mutex_
+
+    mutable std::mutex mutex_;
+    Config config_;
+    std::vector<int> allowedCpus_; // process affinity at startup
+    size_t nextNetworkCpu_;
+    std::vector<Placement> placements_;
+};
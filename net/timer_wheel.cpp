@@ -0,0 +1,84 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point start)
+    : tick_(tick), start_(start), current_(0), size_(0) {}
+
+uint64_t TimerWheel::toTicks(Clock::time_point t) const
+{
+    if (t <= start_)
+    {
+        return 0;
+    }
+    // Round up so an entry never fires before its deadline
+    auto elapsed = t - start_;
+    return static_cast<uint64_t>((elapsed + tick_ - Clock::duration(1)) / tick_);
+}
+
+void TimerWheel::schedule(const std::string &key, uint64_t tag, Clock::time_point deadline)
+{
+    // Overdue entries fire on the next tick
+    uint64_t ticks = std::max(toTicks(deadline), current_ + 1);
+    place(Entry{key, tag, ticks});
+    ++size_;
+}
+
+void TimerWheel::place(Entry &&entry)
+{
+    uint64_t delta = entry.deadline - current_;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (uint64_t(1) << (kBits * (level + 1))))
+    {
+        ++level;
+    }
+    if (level == kLevels - 1 && delta >= (uint64_t(1) << (kBits * kLevels)))
+    {
+        // Clamp to the wheel's horizon; the owner re-checks on expiry anyway
+        entry.deadline = current_ + (uint64_t(1) << (kBits * kLevels)) - 1;
+    }
+    size_t idx = (entry.deadline >> (kBits * level)) & kMask;
+    levels_[level][idx].push_back(std::move(entry));
+}
+
+void TimerWheel::cascade(int level)
+{
+    size_t idx = (current_ >> (kBits * level)) & kMask;
+    // Entries only move to lower levels, so one scratch vector per level is enough.
+    // The slot takes over the scratch's storage; neither side gives its capacity back.
+    std::vector<Entry> &entries = spill_[level];
+    entries.swap(levels_[level][idx]);
+    for (auto &entry : entries)
+    {
+        place(std::move(entry));
+    }
+    entries.clear();
+    if (idx == 0 && level + 1 < kLevels)
+    {
+        cascade(level + 1);
+    }
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<Expired> &expired)
+{
+    uint64_t target = toTicks(now);
+    while (current_ < target && size_ > 0)
+    {
+        ++current_;
+        if ((current_ & kMask) == 0)
+        {
+            cascade(1);
+        }
+        auto &slot = levels_[0][current_ & kMask];
+        for (auto &entry : slot)
+        {
+            expired.push_back(Expired{std::move(entry.key), entry.tag});
+        }
+        size_ -= slot.size();
+        slot.clear();
+    }
+    // Nothing pending: jump straight to now
+    if (size_ == 0 && current_ < target)
+    {
+        current_ = target;
+    }
+}
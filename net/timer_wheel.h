@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 分层时间轮：用一个 tick 驱动任意数量的超时，不需要给每个流单独建 timer。
+// 4 层 x 64 槽，tick 为 250ms 时可覆盖约 48 天。条目不支持显式取消，
+// 由调用方通过 tag（代数）判断到期条目是否仍然有效。
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Expired {
+        std::string key;
+        uint64_t tag;
+    };
+
+    TimerWheel(Clock::duration tick, Clock::time_point start);
+
+    void schedule(const std::string& key, uint64_t tag, Clock::time_point deadline);
+
+    // Advance to `now`, appending every entry whose deadline has passed.
+    void advance(Clock::time_point now, std::vector<Expired>& expired);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    Clock::duration tick() const { return tick_; }
+
+private:
+    static constexpr int kBits = 6;
+    static constexpr int kSlots = 1 << kBits;
+    static constexpr uint64_t kMask = kSlots - 1;
+    static constexpr int kLevels = 4;
+
+    struct Entry {
+        std::string key;
+        uint64_t tag;
+        uint64_t deadline; // in ticks
+    };
+
+    void place(Entry&& entry);
+    void cascade(int level);
+    uint64_t toTicks(Clock::time_point t) const;
+
+    Clock::duration tick_;
+    Clock::time_point start_;
+    uint64_t current_;
+    size_t size_;
+    std::array<std::array<std::vector<Entry>, kSlots>, kLevels> levels_;
+    std::array<std::vector<Entry>, kLevels> spill_; // cascade scratch, keeps its capacity between cascades
+};
@@ -0,0 +1,252 @@
+#include "traffic_capture.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+// Keep windows.h from defining min/max macros over std::min / std::max below
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char kMagic[8] = {'C', 'T', 'C', 'A', 'P', 0, 0, 1};
+
+#pragma pack(push, 1)
+struct FileHeader
+{
+    char magic[8];
+    uint64_t end; // offset just past the last complete record
+};
+
+struct DiskRecord
+{
+    uint64_t timeUs;
+    char stream[6];
+    uint8_t type;
+    uint8_t direction;
+    uint32_t size;
+    uint32_t stored; // payload bytes that follow
+};
+#pragma pack(pop)
+}
+
+TrafficCapture::TrafficCapture()
+    : active_(false), payloads_(false), base_(nullptr), capacity_(0), used_(0), records_(0), dropped_(0),
+#ifdef _WIN32
+      file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+#else
+      fd_(-1)
+#endif
+{
+}
+
+TrafficCapture::~TrafficCapture()
+{
+    stop();
+}
+
+bool TrafficCapture::mapFile(uint64_t capacity, std::string &error)
+{
+#ifdef _WIN32
+    file_ = CreateFileA(path_.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        error = "无法创建文件";
+        return false;
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READWRITE, static_cast<DWORD>(capacity >> 32), static_cast<DWORD>(capacity), nullptr);
+    base_ = mapping_ ? static_cast<char *>(MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, 0)) : nullptr;
+    if (!base_)
+    {
+        error = "内存映射失败";
+        unmapFile();
+        return false;
+    }
+#else
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+    {
+        error = std::strerror(errno);
+        return false;
+    }
+    if (::ftruncate(fd_, static_cast<off_t>(capacity)) != 0)
+    {
+        error = std::strerror(errno);
+        unmapFile();
+        return false;
+    }
+    void *mapped = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapped == MAP_FAILED)
+    {
+        error = std::strerror(errno);
+        unmapFile();
+        return false;
+    }
+    base_ = static_cast<char *>(mapped);
+#endif
+    capacity_ = capacity;
+    return true;
+}
+
+void TrafficCapture::unmapFile()
+{
+#ifdef _WIN32
+    if (base_)
+    {
+        UnmapViewOfFile(base_);
+    }
+    if (mapping_)
+    {
+        CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER size;
+        size.QuadPart = static_cast<LONGLONG>(used_);
+        SetFilePointerEx(file_, size, nullptr, FILE_BEGIN);
+        SetEndOfFile(file_);
+        CloseHandle(file_);
+    }
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = nullptr;
+#else
+    if (base_)
+    {
+        ::munmap(base_, capacity_);
+    }
+    if (fd_ >= 0)
+    {
+        if (::ftruncate(fd_, static_cast<off_t>(used_)) != 0)
+        {
+            // Leaves the preallocated tail; readers stop at the header's end offset
+        }
+        ::close(fd_);
+    }
+    fd_ = -1;
+#endif
+    base_ = nullptr;
+}
+
+bool TrafficCapture::start(const std::string &path, bool payloads, uint64_t capacity, std::string &error)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (active_)
+    {
+        error = "已在捕获中";
+        return false;
+    }
+    path_ = path;
+    payloads_ = payloads;
+    used_ = 0;
+    records_ = 0;
+    dropped_ = 0;
+    if (!mapFile(std::max<uint64_t>(capacity, sizeof(FileHeader) + 1024 * 1024), error))
+    {
+        return false;
+    }
+    FileHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.end = sizeof(FileHeader);
+    std::memcpy(base_, &header, sizeof(header));
+    used_ = sizeof(FileHeader);
+    start_ = std::chrono::steady_clock::now();
+    active_ = true;
+    return true;
+}
+
+void TrafficCapture::stop()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!base_)
+    {
+        return;
+    }
+    active_ = false;
+    unmapFile();
+}
+
+void TrafficCapture::record(CaptureRecord::Type type, CaptureRecord::Direction direction, const std::string &stream,
+                            uint32_t size, const char *payload)
+{
+    if (!active_)
+    {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!base_)
+    {
+        return;
+    }
+    DiskRecord record;
+    record.timeUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - start_).count());
+    std::memset(record.stream, 0, sizeof(record.stream));
+    std::memcpy(record.stream, stream.data(), std::min(stream.size(), sizeof(record.stream)));
+    record.type = type;
+    record.direction = direction;
+    record.size = size;
+    record.stored = payloads_ && payload && type == CaptureRecord::Data ? size : 0;
+    uint64_t length = sizeof(record) + record.stored;
+    if (used_ + length > capacity_)
+    {
+        ++dropped_;
+        return;
+    }
+    std::memcpy(base_ + used_, &record, sizeof(record));
+    if (record.stored > 0)
+    {
+        std::memcpy(base_ + used_ + sizeof(record), payload, record.stored);
+    }
+    used_ += length;
+    ++records_;
+    // Publish the new end last, so a crash mid-record leaves a readable file
+    std::memcpy(base_ + offsetof(FileHeader, end), &used_, sizeof(used_));
+}
+
+CaptureStats TrafficCapture::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return CaptureStats{active_, path_, payloads_, records_, used_, capacity_, dropped_};
+}
+
+bool TrafficCapture::load(const std::string &path, std::vector<CaptureRecord> &out, std::string &error)
+{
+    std::ifstream file(path, std::ios::binary);
+    FileHeader header;
+    if (!file || !file.read(reinterpret_cast<char *>(&header), sizeof(header)) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        error = "不是捕获文件";
+        return false;
+    }
+    uint64_t offset = sizeof(header);
+    DiskRecord record;
+    while (offset + sizeof(record) <= header.end && file.read(reinterpret_cast<char *>(&record), sizeof(record)))
+    {
+        CaptureRecord entry;
+        entry.timeUs = record.timeUs;
+        entry.stream.assign(record.stream, sizeof(record.stream));
+        entry.type = static_cast<CaptureRecord::Type>(record.type);
+        entry.direction = static_cast<CaptureRecord::Direction>(record.direction);
+        entry.size = record.size;
+        entry.payload.resize(record.stored);
+        if (record.stored > 0 && !file.read(entry.payload.data(), record.stored))
+        {
+            break; // Truncated
+        }
+        offset += sizeof(record) + record.stored;
+        out.push_back(std::move(entry));
+    }
+    return true;
+}
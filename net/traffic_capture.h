@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 一条捕获记录（读取端使用的展开形式）
+struct CaptureRecord {
+    enum Type : uint8_t { Open = 0, Close = 1, Data = 2 };
+    enum Direction : uint8_t { Outbound = 0, Inbound = 1 }; // 本地→对端 / 对端→本地
+
+    uint64_t timeUs;            // since the capture started
+    std::string stream;
+    Type type;
+    Direction direction;
+    uint32_t size;              // payload bytes; service index for Open
+    std::vector<char> payload;  // empty unless payloads were captured
+};
+
+struct CaptureStats {
+    bool active;
+    std::string path;
+    bool payloads;
+    uint64_t records;
+    uint64_t bytes;     // file bytes used
+    uint64_t capacity;
+    uint64_t dropped;   // records that did not fit
+};
+
+// 隧道流量捕获：把流的打开/关闭和每个数据块的时间、大小（可选内容）追加写入内存映射文件。
+// 文件在开始时按容量预分配，写满后停止记录并计数，结束时截断到实际长度。
+// 头部随每条记录更新有效长度，进程异常退出时文件仍可读取。
+// 所有对端的 MultiplexManager 共享一份，可在任意线程调用 record()。
+class TrafficCapture {
+public:
+    static const uint64_t kDefaultCapacity = 256ull * 1024 * 1024;
+
+    TrafficCapture();
+    ~TrafficCapture();
+
+    bool start(const std::string& path, bool payloads, uint64_t capacity, std::string& error);
+    void stop();
+    bool active() const { return active_; }
+
+    void record(CaptureRecord::Type type, CaptureRecord::Direction direction, const std::string& stream,
+                uint32_t size, const char* payload = nullptr);
+
+    CaptureStats getStats() const;
+
+    // Reads a capture written by this class (complete or cut short)
+    static bool load(const std::string& path, std::vector<CaptureRecord>& out, std::string& error);
+
+private:
+    bool mapFile(uint64_t capacity, std::string& error);
+    void unmapFile(); // truncates the file to used_
+
+    mutable std::mutex mutex_;
+    std::atomic<bool> active_;
+    bool payloads_;
+    std::string path_;
+    char* base_;
+    uint64_t capacity_;
+    uint64_t used_;
+    uint64_t records_;
+    uint64_t dropped_;
+    std::chrono::steady_clock::time_point start_;
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#else
+    int fd_;
+#endif
+};
@@ -0,0 +1,104 @@
+#include "traffic_shaper.h"
+#include <algorithm>
+
+namespace
+{
+// 至少容纳一次完整读取（128KB），否则低速率下每次读取都会被推迟
+constexpr double kMinBurst = 128.0 * 1024;
+}
+
+TokenBucket::TokenBucket()
+    : rate_(0), burst_(kMinBurst), tokens_(kMinBurst), last_(Clock::now()) {}
+
+void TokenBucket::setRate(uint64_t rate)
+{
+    if (rate == rate_)
+    {
+        return;
+    }
+    refill(Clock::now());
+    rate_ = rate;
+    burst_ = std::max(kMinBurst, static_cast<double>(rate) / 4); // 250ms worth
+    tokens_ = std::min(tokens_, burst_);
+}
+
+void TokenBucket::refill(Clock::time_point now)
+{
+    if (now > last_)
+    {
+        double elapsed = std::chrono::duration<double>(now - last_).count();
+        tokens_ = std::min(burst_, tokens_ + elapsed * static_cast<double>(rate_));
+    }
+    last_ = now;
+}
+
+TokenBucket::Clock::duration TokenBucket::consume(size_t bytes, Clock::time_point now)
+{
+    if (rate_ == 0)
+    {
+        return Clock::duration::zero();
+    }
+    refill(now);
+    tokens_ -= static_cast<double>(bytes);
+    if (tokens_ >= 0)
+    {
+        return Clock::duration::zero();
+    }
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(-tokens_ / static_cast<double>(rate_)));
+}
+
+TrafficShaper::TrafficShaper()
+    : streamRate_(0), peerRate_(0), throttled_(0), throttledMs_(0) {}
+
+void TrafficShaper::setServiceRate(uint32_t service, uint64_t rate)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (service >= services_.size())
+    {
+        services_.resize(service + 1);
+    }
+    services_[service].setRate(rate);
+}
+
+void TrafficShaper::setServiceWeight(uint32_t service, uint32_t weight)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (service >= weights_.size())
+    {
+        weights_.resize(service + 1, 1);
+    }
+    weights_[service] = std::max<uint32_t>(weight, 1);
+}
+
+uint32_t TrafficShaper::serviceWeight(uint32_t service)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return service < weights_.size() ? weights_[service] : 1;
+}
+
+TokenBucket::Clock::duration TrafficShaper::consumeService(uint32_t service, size_t bytes, TokenBucket::Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (service >= services_.size())
+    {
+        return TokenBucket::Clock::duration::zero();
+    }
+    return services_[service].consume(bytes, now);
+}
+
+void TrafficShaper::recordThrottle(TokenBucket::Clock::duration delay)
+{
+    ++throttled_;
+    throttledMs_ += std::chrono::duration_cast<std::chrono::milliseconds>(delay).count();
+}
+
+ShapingStats TrafficShaper::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ShapingStats stats{streamRate_, peerRate_, {}, weights_, throttled_, throttledMs_};
+    for (const auto &bucket : services_)
+    {
+        stats.serviceRates.push_back(bucket.rate());
+    }
+    return stats;
+}
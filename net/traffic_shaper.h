@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// 令牌桶（欠账式）：发送先扣令牌，余额为负时返回需要等待的时长，
+// 由调用方推迟下一次读取，从而对本地 socket 形成 TCP 背压。
+// 不加锁，由持有者负责同步。
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket();
+
+    // rate in bytes/s, 0 = unlimited
+    void setRate(uint64_t rate);
+    uint64_t rate() const { return rate_; }
+
+    // Charges `bytes` and returns how long the sender should pause before the next send
+    Clock::duration consume(size_t bytes, Clock::time_point now);
+
+private:
+    void refill(Clock::time_point now);
+
+    uint64_t rate_;
+    double burst_;
+    double tokens_;
+    Clock::time_point last_;
+};
+
+struct ShapingStats {
+    uint64_t streamRate;
+    uint64_t peerRate;
+    std::vector<uint64_t> serviceRates;
+    std::vector<uint32_t> serviceWeights;
+    uint64_t throttled;     // 因限速推迟的读取次数
+    uint64_t throttledMs;   // 累计推迟时长
+};
+
+// 分层限速：每流 / 每对端 / 每服务（端口映射）三级令牌桶，取三者中最长的等待。
+// 另外保存各服务在发送调度器中的权重。
+// 流和对端的桶由各 MultiplexManager 自己持有，这里只保存速率配置；
+// 服务级的桶跨所有对端共享，因此放在这里统一加锁。速率可运行时修改，立即生效。
+class TrafficShaper {
+public:
+    TrafficShaper();
+
+    void setStreamRate(uint64_t rate) { streamRate_ = rate; }
+    void setPeerRate(uint64_t rate) { peerRate_ = rate; }
+    void setServiceRate(uint32_t service, uint64_t rate);
+    // Relative share of the outbound scheduler for streams of this service (default 1)
+    void setServiceWeight(uint32_t service, uint32_t weight);
+    uint32_t serviceWeight(uint32_t service);
+    uint64_t streamRate() const { return streamRate_; }
+    uint64_t peerRate() const { return peerRate_; }
+
+    TokenBucket::Clock::duration consumeService(uint32_t service, size_t bytes, TokenBucket::Clock::time_point now);
+    void recordThrottle(TokenBucket::Clock::duration delay);
+
+    ShapingStats getStats();
+
+private:
+    std::atomic<uint64_t> streamRate_;
+    std::atomic<uint64_t> peerRate_;
+    std::mutex mutex_;
+    std::vector<TokenBucket> services_;
+    std::vector<uint32_t> weights_;
+    std::atomic<uint64_t> throttled_;
+    std::atomic<uint64_t> throttledMs_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 隧道包头：6 字符流 ID + '\0'，uint32 类型（本机字节序），后接负载
+//   0 数据  1 断开  2 Ping  3 Pong  4 Keepalive  5 打开流（负载为 uint32 服务序号）  6 Keepalive 应答
+//   Keepalive 负载 1 字节 0x01 表示发送方会应答 keepalive（旧版本为空负载）
+struct TunnelHeader {
+    static constexpr size_t kIdLen = 6;
+    static constexpr size_t kSize = kIdLen + 1 + sizeof(uint32_t);
+
+    // Writes kSize bytes; `id` is kIdLen characters
+    static void encode(char* out, const std::string& id, uint32_t type)
+    {
+        std::memcpy(out, id.data(), kIdLen);
+        out[kIdLen] = '\0';
+        std::memcpy(out + kIdLen + 1, &type, sizeof(type));
+    }
+
+    // False if the packet is too short to carry a header; the id is data[0, kIdLen)
+    static bool decode(const char* data, size_t len, uint32_t& type)
+    {
+        if (len < kSize)
+        {
+            return false;
+        }
+        std::memcpy(&type, data + kIdLen + 1, sizeof(type));
+        return true;
+    }
+
+    // Header plus payload, as handed to SendMessageToConnection; `out` holds kSize + len.
+    // Returns the packet size.
+    static size_t write(char* out, const std::string& id, uint32_t type, const char* data, size_t len)
+    {
+        encode(out, id, type);
+        if (!data)
+        {
+            return kSize;
+        }
+        if (len > 0)
+        {
+            std::memcpy(out + kSize, data, len);
+        }
+        return kSize + len;
+    }
+
+    static void build(std::vector<char>& packet, const std::string& id, uint32_t type, const char* data, size_t len)
+    {
+        packet.resize(kSize + (data ? len : 0));
+        write(packet.data(), id, type, data, len);
+    }
+};
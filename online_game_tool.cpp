@@ -1,7 +1,10 @@
 #include "steam/steam_networking_manager.h"
 #include "steam/steam_room_manager.h"
 #include "steam/steam_utils.h"
+#include "steam/startup_milestones.h"
+#include "steam/link_impairment.h"
 #include "tcp_server.h"
+#include "thread_placement.h"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
@@ -25,16 +28,19 @@ using boost::asio::ip::tcp;
 // Global variables
 std::vector<HSteamNetConnection> connections;
 std::mutex connectionsMutex;
-int localPort = 0;
-std::unique_ptr<TCPServer> server;
+ForwardTargetList forwardTargets; // read by the io thread: replace, never modify in place
 std::atomic<bool> isRunning(true);
 std::atomic<bool> monitorMode(false);
 
 // Command queue
 std::queue<std::string> commandQueue;
 std::mutex commandQueueMutex;
+// Constructed before main() so elapsed times are measured from process start
+StartupMilestones startupMilestones;
+std::shared_ptr<ThreadPlacement> threadPlacement = std::make_shared<ThreadPlacement>();
 
 void inputThreadFunc() {
+    threadPlacement->enter(ThreadPlacement::Control, "输入");
     std::string line;
     while (isRunning) {
         if (std::getline(std::cin, line)) {
@@ -46,14 +52,23 @@ void inputThreadFunc() {
 
 void printHelp() {
     std::cout << "\n可用命令：\n";
-    std::cout << "  host <端口>       - 主持大厅（必须指定端口）\n";
-    std::cout << "  join <大厅ID>     - 加入大厅\n";
+    std::cout << "  host <目标,...>   - 主持大厅（端口，或 tcp:主机:端口 / unix:路径；多个映射用逗号分隔）\n";
+    std::cout << "  join <大厅ID> [端口] - 加入大厅（可多次加入不同主机；端口为本地起始监听端口）\n";
+    std::cout << "  lobbies [close/default/far/worldwide] [最大延迟ms] - 搜索公开大厅，按预估延迟排序\n";
     std::cout << "  disconnect        - 离开大厅并停止服务器\n";
     std::cout << "  friends           - 列出 Steam 好友\n";
     std::cout << "  invite <名称>     - 邀请好友（模糊匹配）\n";
     std::cout << "  status            - 显示一次当前状态\n";
     std::cout << "  monitor [on/off]  - 开启/关闭实时状态监控\n";
-    std::cout << "  relay [on/off]    - 开启/关闭强制中继模式 (解决防火墙问题)\n";
+    std::cout << "  relay [on/off/auto] - 开启/关闭强制中继模式 (解决防火墙问题)；auto 按 p95 延迟自动选择直连或中继\n";
+    std::cout << "  pool [on/off]     - 开启/关闭主持端本地预连接池 (降低新连接延迟)\n";
+    std::cout << "  shape [项 值]     - 查看/设置限速 KB/s：stream 每流, peer 每对端, service <序号> 每服务 (0=不限)\n";
+    std::cout << "                      shape weight <序号> <权重> 设置该服务在发送调度中的权重\n";
+    std::cout << "  profile [名称 [连接]] - 查看/切换网络调优配置（lowlatency/bulk/lan 或 tuning_profiles.ini 中定义的），不需重连\n";
+    std::cout << "  limits [项 值]    - 查看/设置准入限制：lobby 人数, peers 对端数, streams 每对端流数, bandwidth 总带宽KB/s, memory 内存MB (0=不限)\n";
+    std::cout << "  impair [设置]     - 链路劣化测试：impair latency=150 jitter=10 loss=2 reorder=1 bandwidth=KB/s | impair clear\n";
+    std::cout << "                      impair run <场景文件> / impair stop；impair proxy <本地端口> <目标> 启动本地劣化代理 / impair proxy off\n";
+    std::cout << "  capture [start <文件> [payload] [MB] | stop] - 捕获隧道流量（默认只记大小，payload 同时记录内容），用 capture_replay 回放\n";
     std::cout << "  netstatus         - 检查 Steam 中继网络状态\n";
     std::cout << "  ping              - 发送应用层 Ping 测试隧道连通性\n";
     std::cout << "  help              - 显示此帮助信息\n";
@@ -91,14 +106,164 @@ extern "C" void __cdecl SteamAPIDebugTextHook(int nSeverity, const char *pchDebu
     // Do nothing to suppress output
 }
 
-void printStatus(SteamNetworkingManager& steamManager, SteamRoomManager& roomManager) {
+void printCapture(const CaptureStats& capture) {
+    printf("[捕获] %s %s%s | %llu 条记录 | %.1f / %.0f MB",
+           capture.active ? "正在写入" : "已停止", capture.path.c_str(), capture.payloads ? "（含内容）" : "",
+           (unsigned long long)capture.records, capture.bytes / (1024.0 * 1024.0), capture.capacity / (1024.0 * 1024.0));
+    if (capture.dropped > 0) {
+        std::cout << " | 已满，丢弃 " << capture.dropped;
+    }
+    std::cout << "\033[K\n";
+}
+
+void printTunnelStats(SteamNetworkingManager& steamManager) {
+    std::vector<HSteamNetConnection> conns;
+    {
+        std::lock_guard<std::mutex> lockConn(connectionsMutex);
+        conns = steamManager.getConnections();
+    }
+    MultiplexStats total{};
+    total.fairness = 1.0;
+    size_t heaviestPeer = 0; // tunnel buffers + Steam send buffer of the busiest peer
+    for (auto conn : conns) {
+        MultiplexStats stats = steamManager.getMessageHandler()->getMultiplexManager(conn)->getStats();
+        total.activeStreams += stats.activeStreams;
+        total.keepalivesSent += stats.keepalivesSent;
+        total.reapedIdle += stats.reapedIdle;
+        total.reapedOrphaned += stats.reapedOrphaned;
+        total.rejectedStreams += stats.rejectedStreams;
+        total.queuedStreams += stats.queuedStreams;
+        total.fairness = std::min(total.fairness, stats.fairness); // worst peer
+        total.inboundMessages += stats.inboundMessages;
+        total.inboundWrites += stats.inboundWrites;
+        total.inboundBatches += stats.inboundBatches;
+        total.memoryBytes += stats.memoryBytes;
+        total.largestStream = std::max(total.largestStream, stats.largestStream);
+        heaviestPeer = std::max(heaviestPeer, stats.memoryBytes + stats.steamPending);
+    }
+    std::cout << "隧道流：" << total.activeStreams << " | Keepalive：" << total.keepalivesSent
+              << " | 回收(空闲/孤立)：" << total.reapedIdle << "/" << total.reapedOrphaned;
+    printf(" | 待发送流：%zu | 公平指数：%.2f", total.queuedStreams, total.fairness);
+    if (total.rejectedStreams > 0) {
+        std::cout << " | 超限拒绝：" << total.rejectedStreams;
+    }
+    std::cout << "\033[K\n";
+    if (total.inboundWrites > 0) {
+        // Each gather write replaces one write per message
+        uint64_t saved = total.inboundMessages - total.inboundWrites;
+        printf("本地写入：%llu 条消息 / %llu 次聚合写 | 节省系统调用 %llu (每批 %.1f)\033[K\n",
+               (unsigned long long)total.inboundMessages, (unsigned long long)total.inboundWrites,
+               (unsigned long long)saved, total.inboundBatches ? (double)saved / total.inboundBatches : 0.0);
+    }
+
+    MemoryStats memory = steamManager.getMessageHandler()->getMemoryBudget()->getStats();
+    printf("内存：读缓冲 %.1f MB + 待写入 %.1f MB + Steam 待发 %.1f MB",
+           memory.reserved / (1024.0 * 1024.0), memory.buffered / (1024.0 * 1024.0), memory.steamPending / (1024.0 * 1024.0));
+    if (memory.limit > 0) {
+        printf(" / 上限 %.0f MB", memory.limit / (1024.0 * 1024.0));
+    }
+    printf(" | 最大对端 %.1f MB | 最大单流 %zu KB", heaviestPeer / (1024.0 * 1024.0), total.largestStream / 1024);
+    if (memory.refusedOpens > 0 || memory.pausedReads > 0) {
+        std::cout << " | 拒绝新流 " << memory.refusedOpens << " | 暂停读取 " << memory.pausedReads;
+    }
+    std::cout << "\033[K\n";
+
+    ReceiveStats receive = steamManager.getMessageHandler()->getReceiveStats();
+    uint64_t batches = 0;
+    for (auto count : receive.histogram) {
+        batches += count;
+    }
+    if (batches > 0) {
+        std::cout << "接收批次：批大小上限 " << receive.maxBatchSize << " | 分布";
+        for (int i = 0; i < ReceiveStats::kBuckets; ++i) {
+            if (receive.histogram[i] == 0) {
+                continue;
+            }
+            int low = 1 << i;
+            std::cout << " " << (i == ReceiveStats::kBuckets - 1 ? std::to_string(low) + "+" :
+                                 low == 1 ? std::string("1") : std::to_string(low) + "-" + std::to_string(2 * low - 1))
+                      << ":" << receive.histogram[i];
+        }
+        std::cout << " | 时间片用尽 " << receive.budgetYields << "\033[K\n";
+    }
+
+    CaptureStats capture = steamManager.getMessageHandler()->getTrafficCapture()->getStats();
+    if (capture.active) {
+        printCapture(capture);
+    }
+}
+
+void printLimits(SteamNetworkingManager& steamManager) {
+    AdmissionPolicy policy = steamManager.getAdmissionPolicy();
+    auto limitText = [](long long value) { return value > 0 ? std::to_string(value) : std::string("不限"); };
+    std::cout << "[准入] 大厅人数 " << policy.lobbyCapacity << " | 对端 " << limitText(policy.maxPeers)
+              << " | 每对端流数 " << limitText(policy.maxStreamsPerPeer)
+              << " | 总带宽 " << (policy.bandwidthBudget > 0 ? std::to_string(policy.bandwidthBudget / 1024) + " KB/s" : std::string("不限"))
+              << " | 内存 " << (policy.memoryBudget > 0 ? std::to_string(policy.memoryBudget / (1024 * 1024)) + " MB" : std::string("不限"))
+              << " | 未接入 " << steamManager.getUnacceptedPeerCount() << "\033[K\n";
+    // Peers over the limits are not queued: Steam drops an unaccepted connection after its initial timeout
+    int timeoutMs = steamManager.getUnacceptedPeerTimeoutMs();
+    std::cout << "       超出限制的对端不排队：" << (timeoutMs > 0 ? std::to_string(timeoutMs / 1000) + " 秒" : std::string("Steam 初始连接超时"))
+              << "内有空位才接入，否则对端连接失败\033[K\n";
+}
+
+void printRateControl(SteamNetworkingManager& steamManager) {
+    for (const auto& rate : steamManager.getRateControlStats()) {
+        printf("[发送速率] 连接 %u [%s]: %.2f MB/s %c (%s) | RTT %d/%d ms 排队 %d ms | 待发 %d KB | 质量 %.2f | 升/降 %llu/%llu%s\033[K\n",
+               rate.connection, steamManager.getConnectionTuningProfile(rate.connection).c_str(), rate.rate / (1024.0 * 1024.0), rate.lastAction, rate.lastReason,
+               rate.smoothedRttMs, rate.baseRttMs, rate.queueDelayMs, rate.pendingBytes / 1024, rate.quality,
+               (unsigned long long)rate.increases, (unsigned long long)rate.decreases,
+               rate.ceiling > 0 ? (" | 上限 " + std::to_string(rate.ceiling / 1024) + " KB/s").c_str() : "");
+    }
+}
+
+void printShaping(SteamNetworkingManager& steamManager, bool always) {
+    ShapingStats shaping = steamManager.getMessageHandler()->getTrafficShaper()->getStats();
+    bool limited = shaping.streamRate > 0 || shaping.peerRate > 0;
+    for (uint64_t rate : shaping.serviceRates) {
+        limited = limited || rate > 0;
+    }
+    for (uint32_t weight : shaping.serviceWeights) {
+        limited = limited || weight > 1;
+    }
+    if (!always && !limited && shaping.throttled == 0) {
+        return;
+    }
+    auto rateText = [](uint64_t rate) { return rate > 0 ? std::to_string(rate / 1024) + " KB/s" : std::string("不限"); };
+    std::cout << "[限速] 每流 " << rateText(shaping.streamRate) << " | 每对端 " << rateText(shaping.peerRate);
+    for (size_t i = 0; i < shaping.serviceRates.size(); ++i) {
+        if (shaping.serviceRates[i] > 0) {
+            std::cout << " | 服务#" << i << " " << rateText(shaping.serviceRates[i]);
+        }
+    }
+    for (size_t i = 0; i < shaping.serviceWeights.size(); ++i) {
+        if (shaping.serviceWeights[i] > 1) {
+            std::cout << " | 服务#" << i << " 权重 " << shaping.serviceWeights[i];
+        }
+    }
+    std::cout << " | 推迟读取 " << shaping.throttled << " 次 (" << shaping.throttledMs << " ms)\033[K\n";
+}
+
+void printStatus(SteamNetworkingManager& steamManager, SteamRoomManager& roomManager, const LinkImpairment& impairment) {
     if (monitorMode) {
         clearScreen();
         std::cout << "=== 实时监控（输入 'monitor off' 停止） ===\033[K\n\n";
     }
 
     if (steamManager.isHost()) {
-        std::cout << "[主机] 正在主持大厅。本地端口：" << localPort << "\033[K\n";
+        std::cout << "[主机] 正在主持大厅。转发目标：";
+        ForwardTargetList::Snapshot targets = forwardTargets.load();
+        for (size_t i = 0; i < targets->size(); ++i) {
+            std::cout << (i ? ", " : "") << "#" << i << " " << (*targets)[i].toString();
+        }
+        std::cout << "\033[K\n";
+        ConnectionPoolStats pool = steamManager.getMessageHandler()->getConnectionPool()->getStats();
+        if (pool.enabled) {
+            printf("[预连接池] 空闲 %zu/%zu | 开流速率 %.2f/s | 命中 %llu 未命中 %llu 回收 %llu\033[K\n",
+                   pool.idle, pool.target, pool.opensPerSec, (unsigned long long)pool.hits,
+                   (unsigned long long)pool.misses, (unsigned long long)pool.recycled);
+        }
+        printLimits(steamManager);
     } else if (steamManager.isConnected()) {
         std::cout << "[客户端] 已连接到大厅。\033[K\n";
     } else {
@@ -107,6 +272,7 @@ void printStatus(SteamNetworkingManager& steamManager, SteamRoomManager& roomMan
         if (!lastError.empty()) {
             std::cout << "[信息] " << lastError << "\033[K\n";
         }
+        std::cout << "[线程] " << threadPlacement->summary() << "\033[K\n";
         // If not connected and in monitor mode, we still want to clear the rest of the screen
         if (monitorMode) std::cout << "\033[J";
         return;
@@ -166,9 +332,50 @@ void printStatus(SteamNetworkingManager& steamManager, SteamRoomManager& roomMan
         }
     }
     
-    if (server) {
-        std::cout << "\nTCP 服务器端口：8888 | 客户端数：" << server->getClientCount() << "\033[K\n";
+    std::vector<HostSessionInfo> sessions = steamManager.getHostSessions();
+    std::vector<PathStats> paths = steamManager.getPathStats();
+    auto msText = [](int ms) { return ms >= 0 ? std::to_string(ms) + " ms" : std::string("-"); };
+    if (!sessions.empty()) {
+        std::cout << "\n主机会话：\033[K\n";
+    }
+    for (const auto& session : sessions) {
+        std::cout << " - " << SteamFriends()->GetFriendPersonaName(session.hostID) << " (" << session.hostID.ConvertToUint64() << ")";
+        if (session.connection != k_HSteamNetConnection_Invalid) {
+            std::cout << " | 延迟 " << steamManager.getConnectionPing(session.connection) << " ms | "
+                      << steamManager.getConnectionRelayInfo(session.connection);
+        } else {
+            std::cout << " | 已断开";
+        }
+        std::cout << "\033[K\n   TCP 服务器端口：";
+        for (size_t i = 0; i < session.ports.size(); ++i) {
+            std::cout << (i ? "," : "") << session.ports[i];
+        }
+        std::cout << " | 客户端数：" << session.clientCount << "\033[K\n";
+        for (const auto& path : paths) {
+            if (path.peer != session.hostID) continue;
+            std::cout << "   选路：直连 p95 " << msText(path.directP95Ms) << " (" << path.directSamples << " 样本)"
+                      << " | 中继 p95 " << msText(path.relayP95Ms) << " (" << path.relaySamples << " 样本, 估算 " << msText(path.relayEstimateMs) << ")"
+                      << " | 倾向 " << (path.preferRelay ? "中继" : "直连") << " | 切换 " << path.switches << " 次 | " << path.lastDecision;
+            if (steamManager.getPathMode() != PathMode::Auto) std::cout << " (未开启 relay auto)";
+            std::cout << "\033[K\n";
+        }
+        const PendingAcceptStats& pending = session.pending;
+        if (pending.queued > 0 || pending.attached > 0 || pending.timedOut > 0) {
+            std::cout << "   等待 P2P 的连接：" << pending.queued << " | 已接入：" << pending.attached
+                      << " (平均等待 " << (pending.attached ? pending.totalWaitMs / pending.attached : 0)
+                      << " ms, 最长 " << pending.maxWaitMs << " ms) | 超时：" << pending.timedOut
+                      << " | 队列满拒绝：" << pending.rejected << "\033[K\n";
+        }
+    }
+
+    printTunnelStats(steamManager);
+    printRateControl(steamManager);
+    printShaping(steamManager, false);
+    if (impairment.current().active() || impairment.scenarioRunning()) {
+        impairment.printStatus();
     }
+    std::cout << "[启动] " << startupMilestones.summary() << "\033[K\n";
+    std::cout << "[线程] " << threadPlacement->summary() << "\033[K\n";
     
     if (monitorMode) {
         // Clear from cursor to end of screen to remove any leftover text from previous frames
@@ -181,18 +388,45 @@ void printStatus(SteamNetworkingManager& steamManager, SteamRoomManager& roomMan
 int main(int argc, char* argv[]) {
     enableAnsi(); // Enable ANSI, UTF-8, and disable Quick Edit FIRST
 
+    // Thread placement has to be known before our first thread starts
+    ThreadPlacement::Config placement;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "+net_cpus" && !ThreadPlacement::parseCpuList(argv[i + 1], placement.networkCpus)) {
+            std::cerr << "无效 CPU 列表：" << argv[i + 1] << "（例如 2,3 或 2-5）\n";
+        } else if (arg == "+net_priority" && !ThreadPlacement::parsePriority(argv[i + 1], placement)) {
+            std::cerr << "无效优先级：" << argv[i + 1] << "（fifo[:1-99] / nice:-20..19 / normal）\n";
+        }
+    }
+    std::string placementError;
+    if (!threadPlacement->configure(placement, placementError)) {
+        std::cerr << "[线程] " << placementError << "，不绑核\n";
+    }
+
     // Initialize Steam API
     if (!SteamAPI_Init()) {
         std::cerr << "初始化 Steam API 失败" << std::endl;
         return 1;
     }
+    startupMilestones.mark(StartupMilestones::ApiUp);
+
+    // Start relay config download and ping measurement first: they take seconds and
+    // run inside Steam, overlapping with the rest of our initialization
+    SteamNetworkingManager::prewarmRelayNetwork();
 
     // Suppress Steam API warnings/logs
     SteamUtils()->SetWarningMessageHook(&SteamAPIDebugTextHook);
 
+    // Accept commands right away; they queue until the main loop starts
+    std::thread inputThread(inputThreadFunc);
+    inputThread.detach();
+
     boost::asio::io_context io_context;
     auto work_guard = boost::asio::make_work_guard(io_context);
-    std::thread io_thread([&io_context]() { io_context.run(); });
+    std::thread io_thread([&io_context]() {
+        threadPlacement->enter(ThreadPlacement::Network, "io");
+        io_context.run();
+    });
 
     // Initialize Managers
     SteamNetworkingManager steamManager;
@@ -203,10 +437,18 @@ int main(int argc, char* argv[]) {
     }
 
     SteamRoomManager roomManager(&steamManager);
+    LinkImpairment impairment(io_context);
     
     // Set dependencies
-    steamManager.setMessageHandlerDependencies(io_context, server, localPort);
+    steamManager.setMessageHandlerDependencies(io_context, forwardTargets);
+    steamManager.setThreadPlacement(threadPlacement);
     steamManager.startMessageHandler();
+    startupMilestones.mark(StartupMilestones::ManagerReady);
+
+    // Only now: Steam's own threads (client pipe, networking sockets service) are started by the
+    // init steps above and inherit the creating thread's affinity. Pinning the main loop earlier
+    // would confine them to the control CPUs; this way they keep the process's startup CPU set.
+    threadPlacement->enter(ThreadPlacement::Control, "主循环");
 
     // Check for command line arguments (Steam Invite)
     for (int i = 1; i < argc; ++i) {
@@ -220,21 +462,26 @@ int main(int argc, char* argv[]) {
             } else {
                 std::cerr << "加入大厅请求失败\n";
             }
+        } else if (arg == "+impair" && i + 1 < argc) {
+            // Scripted impairment scenario for reproducible benchmark runs
+            impairment.runScenario(argv[i + 1]);
         }
     }
 
-    std::cout << "ConnectTool 命令行工具已启动。\n";
+    std::cout << "ConnectTool 命令行工具已启动。(I/O 后端：" << asioBackendName() << ")\n";
     printHelp();
 
-    // Start input thread
-    std::thread inputThread(inputThreadFunc);
-    inputThread.detach();
-
     auto lastStatusTime = std::chrono::steady_clock::now();
 
     while (isRunning) {
         SteamAPI_RunCallbacks();
         steamManager.update();
+        roomManager.update();
+        startupMilestones.poll(steamManager);
+        if (impairment.scenarioRunning()) {
+            std::lock_guard<std::mutex> lockConn(connectionsMutex);
+            impairment.update(steamManager.getConnections());
+        }
 
         // Process commands
         std::string command;
@@ -269,45 +516,60 @@ int main(int argc, char* argv[]) {
             } else if (command == "help") {
                 printHelp();
             } else if (checkCommand("host")) {
-                int port = 0;
-                try {
-                    if (!arg.empty()) {
-                        port = std::stoi(arg);
-                        localPort = port;
-                        roomManager.startHosting();
-                        std::cout << "正在本地端口 " << localPort << " 主持大厅...\n";
-                        std::cout << "[注意] 如果您在 VPS 或 Windows Server 上运行，请务必在防火墙中放行本程序 (UDP/TCP)。\n";
-                        monitorMode = true;
-                    } else {
-                        std::cout << "用法：host <端口>\n";
+                std::vector<ForwardTarget> targets;
+                if (arg.empty()) {
+                    std::cout << "用法：host <端口 | tcp:主机:端口 | unix:路径>[,...]\n";
+                } else if (!ForwardTarget::parseList(arg, targets)) {
+                    std::cout << "无效转发目标：" << arg << "\n";
+                } else {
+                    forwardTargets.store(targets);
+                    roomManager.startHosting();
+                    std::cout << "正在主持大厅，转发到 ";
+                    for (size_t i = 0; i < targets.size(); ++i) {
+                        std::cout << (i ? ", " : "") << targets[i].toString() << " (客户端本地端口 " << 8888 + i << ")";
                     }
-                } catch (...) {
-                    std::cout << "无效端口号\n";
+                    std::cout << "...\n";
+                    std::cout << "[注意] 如果您在 VPS 或 Windows Server 上运行，请务必在防火墙中放行本程序 (UDP/TCP)。\n";
+                    monitorMode = true;
                 }
             } else if (checkCommand("join")) {
                 uint64 lobbyIDVal = 0;
                 try {
                     if (!arg.empty()) {
-                        lobbyIDVal = std::stoull(arg);
-                        if (roomManager.joinLobby(lobbyIDVal)) {
+                        std::istringstream joinArgs(arg);
+                        std::string lobbyText;
+                        int basePort = 0;
+                        joinArgs >> lobbyText >> basePort;
+                        lobbyIDVal = std::stoull(lobbyText);
+                        if (roomManager.joinLobby(lobbyIDVal, basePort)) {
                             std::cout << "正在加入大厅 " << lobbyIDVal << "...\n";
                             monitorMode = true;
                         } else {
                             std::cout << "加入大厅请求失败。\n";
                         }
                     } else {
-                        std::cout << "用法：join <大厅ID>\n";
+                        std::cout << "用法：join <大厅ID> [起始端口]\n";
                     }
                 } catch (...) {
                     std::cout << "无效大厅ID: " << arg << " (请检查ID是否正确)\n";
                 }
+            } else if (checkCommand("lobbies")) {
+                std::istringstream searchArgs(arg);
+                std::string distanceText = "default";
+                int maxPing = 0;
+                searchArgs >> distanceText >> maxPing;
+                ELobbyDistanceFilter distance = k_ELobbyDistanceFilterDefault;
+                if (distanceText == "close") distance = k_ELobbyDistanceFilterClose;
+                else if (distanceText == "far") distance = k_ELobbyDistanceFilterFar;
+                else if (distanceText == "worldwide") distance = k_ELobbyDistanceFilterWorldwide;
+                if (roomManager.searchLobbies(distance, maxPing)) {
+                    std::cout << "正在搜索大厅...\n";
+                } else {
+                    std::cout << "搜索大厅请求失败。\n";
+                }
             } else if (command == "disconnect") {
                 roomManager.leaveLobby();
                 steamManager.disconnect();
-                if (server) {
-                    server->stop();
-                    server.reset();
-                }
                 monitorMode = false;
                 std::cout << "已断开连接。\n";
             } else if (command == "friends") {
@@ -338,7 +600,7 @@ int main(int argc, char* argv[]) {
                     if (!found) std::cout << "未找到匹配 '" << filter << "' 的好友\n";
                 }
             } else if (command == "status") {
-                printStatus(steamManager, roomManager);
+                printStatus(steamManager, roomManager, impairment);
             } else if (checkCommand("monitor")) {
                 if (arg == "on") monitorMode = true;
                 else if (arg == "off") monitorMode = false;
@@ -346,9 +608,194 @@ int main(int argc, char* argv[]) {
             } else if (checkCommand("relay")) {
                 if (arg == "on") steamManager.setForceRelay(true);
                 else if (arg == "off") steamManager.setForceRelay(false);
-                else std::cout << "用法：relay [on/off]\n";
+                else if (arg == "auto") steamManager.setPathMode(PathMode::Auto);
+                else std::cout << "用法：relay [on/off/auto]\n";
+            } else if (checkCommand("pool")) {
+                if (arg == "on" || arg == "off") {
+                    steamManager.getMessageHandler()->getConnectionPool()->setEnabled(arg == "on");
+                    std::cout << (arg == "on" ? "[配置] 已开启本地预连接池。" : "[配置] 已关闭本地预连接池。") << "\n";
+                } else {
+                    std::cout << "用法：pool [on/off]\n";
+                }
+            } else if (checkCommand("limits")) {
+                if (arg.empty()) {
+                    printLimits(steamManager);
+                } else {
+                    std::istringstream limitArgs(arg);
+                    std::string key;
+                    long long value = -1;
+                    limitArgs >> key >> value;
+                    AdmissionPolicy policy = steamManager.getAdmissionPolicy();
+                    bool valid = true;
+                    if (value < 0) {
+                        valid = false;
+                    } else if (key == "lobby") {
+                        policy.lobbyCapacity = static_cast<int>(std::min<long long>(value, kMaxLobbyMembers));
+                    } else if (key == "peers") {
+                        policy.maxPeers = static_cast<int>(value);
+                    } else if (key == "streams") {
+                        policy.maxStreamsPerPeer = static_cast<int>(value);
+                    } else if (key == "bandwidth") {
+                        policy.bandwidthBudget = value * 1024;
+                    } else if (key == "memory") {
+                        policy.memoryBudget = value * 1024 * 1024;
+                    } else {
+                        valid = false;
+                    }
+                    if (valid) {
+                        steamManager.setAdmissionPolicy(policy);
+                        if (key == "lobby") roomManager.applyLobbyCapacity();
+                        printLimits(steamManager);
+                    } else {
+                        std::cout << "用法：limits [lobby|peers|streams|bandwidth|memory] <值>\n";
+                    }
+                }
+            } else if (checkCommand("shape")) {
+                std::istringstream shapeArgs(arg);
+                std::string key;
+                shapeArgs >> key;
+                long long service = 0;
+                if (key == "service" || key == "weight") shapeArgs >> service;
+                long long rateKB = -1;
+                shapeArgs >> rateKB;
+                auto shaper = steamManager.getMessageHandler()->getTrafficShaper();
+                if (arg.empty()) {
+                    printShaping(steamManager, true);
+                } else if (rateKB < 0 || service < 0) {
+                    std::cout << "用法：shape [stream|peer|service <序号>] <KB/s>\n";
+                } else if (key == "stream") {
+                    shaper->setStreamRate(static_cast<uint64_t>(rateKB) * 1024);
+                    printShaping(steamManager, true);
+                } else if (key == "peer") {
+                    shaper->setPeerRate(static_cast<uint64_t>(rateKB) * 1024);
+                    printShaping(steamManager, true);
+                } else if (key == "service") {
+                    shaper->setServiceRate(static_cast<uint32_t>(service), static_cast<uint64_t>(rateKB) * 1024);
+                    printShaping(steamManager, true);
+                } else if (key == "weight") {
+                    shaper->setServiceWeight(static_cast<uint32_t>(service), static_cast<uint32_t>(std::min<long long>(rateKB, 64)));
+                    printShaping(steamManager, true);
+                } else {
+                    std::cout << "用法：shape [stream|peer|service <序号>] <KB/s> | shape weight <序号> <权重>\n";
+                }
+            } else if (checkCommand("profile")) {
+                std::istringstream profileArgs(arg);
+                std::string name;
+                long long connArg = -1;
+                profileArgs >> name >> connArg;
+                std::vector<HSteamNetConnection> conns;
+                {
+                    std::lock_guard<std::mutex> lockConn(connectionsMutex);
+                    conns = steamManager.getConnections();
+                }
+                if (name.empty()) {
+                    std::cout << "可用调优配置：";
+                    for (const auto& profileName : steamManager.getTuningProfileNames()) {
+                        std::cout << profileName << (profileName == steamManager.getDefaultTuningProfile() ? "(默认) " : " ");
+                    }
+                    std::cout << "\n";
+                    for (auto conn : conns) {
+                        std::cout << " - 连接 " << conn << ": " << steamManager.getConnectionTuningProfile(conn) << "\n";
+                    }
+                } else if (connArg >= 0) {
+                    if (steamManager.setConnectionTuningProfile(static_cast<HSteamNetConnection>(connArg), name)) {
+                        std::cout << "[配置] 连接 " << connArg << " 已切换到 " << name << "\n";
+                    } else {
+                        std::cout << "切换失败：配置或连接不存在。\n";
+                    }
+                } else if (steamManager.setDefaultTuningProfile(name)) {
+                    // Default for new connections, and switch every live one
+                    for (auto conn : conns) {
+                        steamManager.setConnectionTuningProfile(conn, name);
+                    }
+                    std::cout << "[配置] 已切换到调优配置 " << name << "（" << conns.size() << " 个连接）\n";
+                } else {
+                    std::cout << "未知调优配置：" << name << "\n";
+                }
+            } else if (checkCommand("impair")) {
+                std::vector<HSteamNetConnection> conns;
+                {
+                    std::lock_guard<std::mutex> lockConn(connectionsMutex);
+                    conns = steamManager.getConnections();
+                }
+                std::istringstream impairArgs(arg);
+                std::string key;
+                impairArgs >> key;
+                if (key.empty()) {
+                    impairment.printStatus();
+                } else if (key == "run") {
+                    std::string path;
+                    impairArgs >> path;
+                    if (path.empty() || !impairment.runScenario(path)) {
+                        std::cout << "用法：impair run <场景文件>\n";
+                    }
+                } else if (key == "stop") {
+                    impairment.stopScenario();
+                } else if (key == "proxy") {
+                    std::string portText;
+                    std::string targetSpec;
+                    impairArgs >> portText >> targetSpec;
+                    ForwardTarget target;
+                    std::string error;
+                    if (portText == "off") {
+                        impairment.removeProxies();
+                        std::cout << "[劣化] 已关闭本地代理\n";
+                    } else if (portText.empty() || portText.size() > 5 || portText.find_first_not_of("0123456789") != std::string::npos ||
+                               std::stoul(portText) == 0 || std::stoul(portText) > 65535 || !ForwardTarget::parse(targetSpec, target)) {
+                        std::cout << "用法：impair proxy <本地端口> <目标>\n";
+                    } else if (!impairment.addProxy(static_cast<unsigned short>(std::stoul(portText)), target, error)) {
+                        std::cout << "启动代理失败：" << error << "\n";
+                    }
+                } else {
+                    // Manual settings end any running scenario
+                    impairment.stopScenario();
+                    Impairment settings = impairment.current();
+                    std::string error;
+                    if (settings.apply(arg, error)) {
+                        impairment.set(settings, conns);
+                    } else {
+                        std::cout << "无法识别：" << error << "（可用 latency/jitter/loss/reorder/bandwidth=值 或 clear）\n";
+                    }
+                }
+            } else if (checkCommand("capture")) {
+                auto capture = steamManager.getMessageHandler()->getTrafficCapture();
+                std::istringstream captureArgs(arg);
+                std::string key;
+                std::string path;
+                captureArgs >> key >> path;
+                bool payloads = false;
+                long long capacityMB = TrafficCapture::kDefaultCapacity / (1024 * 1024);
+                std::string option;
+                while (captureArgs >> option) {
+                    if (option == "payload") {
+                        payloads = true;
+                    } else if (option.find_first_not_of("0123456789") == std::string::npos && option.size() <= 6) {
+                        capacityMB = std::stoll(option);
+                    }
+                }
+                if (key.empty()) {
+                    CaptureStats stats = capture->getStats();
+                    if (stats.path.empty()) {
+                        std::cout << "[捕获] 未开启\n";
+                    } else {
+                        printCapture(stats);
+                    }
+                } else if (key == "start" && !path.empty()) {
+                    std::string error;
+                    if (capture->start(path, payloads, static_cast<uint64_t>(capacityMB) * 1024 * 1024, error)) {
+                        std::cout << "[捕获] 开始写入 " << path << (payloads ? "（含内容）" : "") << "，上限 " << capacityMB << " MB\n";
+                    } else {
+                        std::cout << "无法开始捕获：" << error << "\n";
+                    }
+                } else if (key == "stop") {
+                    capture->stop();
+                    printCapture(capture->getStats());
+                } else {
+                    std::cout << "用法：capture start <文件> [payload] [MB] | capture stop\n";
+                }
             } else if (command == "netstatus") {
                 steamManager.printRelayStatus();
+                std::cout << "[启动] " << startupMilestones.summary() << "\n";
             } else if (command == "ping") {
                 steamManager.sendPing();
             } else {
@@ -362,7 +809,7 @@ int main(int argc, char* argv[]) {
         if (monitorMode) {
             auto now = std::chrono::steady_clock::now();
             if (std::chrono::duration_cast<std::chrono::seconds>(now - lastStatusTime).count() >= 1) {
-                printStatus(steamManager, roomManager);
+                printStatus(steamManager, roomManager, impairment);
                 lastStatusTime = now;
             }
         }
@@ -372,7 +819,8 @@ int main(int argc, char* argv[]) {
 
     // Cleanup
     steamManager.stopMessageHandler();
-    if (server) server->stop();
+    steamManager.getMessageHandler()->getTrafficCapture()->stop();
+    steamManager.closeHostSessions();
     
     work_guard.reset();
     io_context.stop();
@@ -0,0 +1,138 @@
+#include "link_impairment.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <isteamnetworkingutils.h>
+
+LinkImpairment::LinkImpairment(boost::asio::io_context &io_context)
+    : io_context_(io_context), seed_(1), nextStep_(0)
+{
+}
+
+void LinkImpairment::applyToSteam(const Impairment &impairment, const std::vector<HSteamNetConnection> &connections)
+{
+    ISteamNetworkingUtils *utils = SteamNetworkingUtils();
+    // Lag, loss and reorder are global-only in Steam; half of the added RTT on each direction
+    utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketLag_Send, impairment.latencyMs / 2);
+    utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketLag_Recv, impairment.latencyMs - impairment.latencyMs / 2);
+    utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketLoss_Send, impairment.lossPercent);
+    utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketLoss_Recv, impairment.lossPercent);
+    // Steam has no random lag: jitter becomes "half the packets arrive jitterMs late"
+    float reorder = impairment.reorderPercent;
+    if (impairment.jitterMs > 0)
+    {
+        reorder = std::max(reorder, 50.0f);
+    }
+    utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketReorder_Send, reorder);
+    utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketReorder_Recv, reorder);
+    utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketReorder_Time, std::max(impairment.jitterMs, 15));
+
+    // The rate limit is per connection: global default for new ones, then each open one
+    int32 rate = impairment.bandwidthKBps * 1024;
+    utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakeRateLimit_Send_Rate, rate);
+    utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakeRateLimit_Recv_Rate, rate);
+    for (auto conn : connections)
+    {
+        utils->SetConnectionConfigValueInt32(conn, k_ESteamNetworkingConfig_FakeRateLimit_Send_Rate, rate);
+        utils->SetConnectionConfigValueInt32(conn, k_ESteamNetworkingConfig_FakeRateLimit_Recv_Rate, rate);
+    }
+}
+
+void LinkImpairment::set(const Impairment &impairment, const std::vector<HSteamNetConnection> &connections)
+{
+    current_ = impairment;
+    applyToSteam(current_, connections);
+    for (auto &proxy : proxies_)
+    {
+        proxy->setImpairment(current_);
+    }
+    std::cout << "[劣化] " << current_.describe() << std::endl;
+}
+
+bool LinkImpairment::runScenario(const std::string &path)
+{
+    ImpairmentScenario scenario;
+    if (!scenario.loadFile(path))
+    {
+        return false;
+    }
+    scenario_ = scenario;
+    seed_ = scenario_.seed();
+    for (auto &proxy : proxies_)
+    {
+        proxy->seed(seed_);
+    }
+    nextStep_ = 0;
+    scenarioStart_ = std::chrono::steady_clock::now();
+    std::cout << "[劣化] 开始场景 " << scenario_.name() << "（" << scenario_.steps().size() << " 步，seed " << seed_ << "）" << std::endl;
+    return true;
+}
+
+void LinkImpairment::stopScenario()
+{
+    if (scenarioRunning())
+    {
+        std::cout << "[劣化] 已停止场景 " << scenario_.name() << std::endl;
+    }
+    scenario_ = ImpairmentScenario();
+    nextStep_ = 0;
+}
+
+void LinkImpairment::update(const std::vector<HSteamNetConnection> &connections)
+{
+    if (!scenarioRunning())
+    {
+        return;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - scenarioStart_).count();
+    const auto &steps = scenario_.steps();
+    while (nextStep_ < steps.size() && steps[nextStep_].atSeconds <= elapsed)
+    {
+        const auto &step = steps[nextStep_++];
+        std::cout << "[劣化] 场景 t=" << step.atSeconds << "s: " << step.settings << "\033[K\n";
+        set(step.impairment, connections);
+    }
+    if (nextStep_ == steps.size())
+    {
+        std::cout << "[劣化] 场景 " << scenario_.name() << " 结束，保留最后的设置\033[K\n";
+    }
+}
+
+bool LinkImpairment::addProxy(unsigned short listenPort, const ForwardTarget &target, std::string &error)
+{
+    auto proxy = std::make_shared<ImpairmentProxy>(io_context_, listenPort, target, seed_);
+    if (!proxy->start(error))
+    {
+        return false;
+    }
+    proxy->setImpairment(current_);
+    proxies_.push_back(proxy);
+    std::cout << "[劣化] 本地代理 127.0.0.1:" << listenPort << " -> " << target.toString() << std::endl;
+    return true;
+}
+
+void LinkImpairment::removeProxies()
+{
+    for (auto &proxy : proxies_)
+    {
+        proxy->stop();
+    }
+    proxies_.clear();
+}
+
+void LinkImpairment::printStatus() const
+{
+    std::cout << "[劣化] 当前：" << current_.describe();
+    if (scenarioRunning())
+    {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - scenarioStart_).count();
+        printf(" | 场景 %s %.0fs (第 %zu/%zu 步)", scenario_.name().c_str(), elapsed, nextStep_, scenario_.steps().size());
+    }
+    std::cout << "\033[K\n";
+    for (const auto &proxy : proxies_)
+    {
+        ImpairmentProxyStats stats = proxy->getStats();
+        std::cout << "   代理 127.0.0.1:" << stats.listenPort << " -> " << stats.target << " | 连接 " << stats.connections
+                  << " | " << stats.bytes / 1024 << " KB | 模拟丢包 " << stats.lostChunks << " | 延后 " << stats.reorderedChunks << "\033[K\n";
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef LINK_IMPAIRMENT_H
+#define LINK_IMPAIRMENT_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <steam_api.h>
+#include <steamnetworkingtypes.h>
+#include "../net/impairment.h"
+#include "../net/impairment_proxy.h"
+
+// 链路劣化：把同一组参数应用到 Steam 连接（Fake* 配置项）和本地劣化代理，
+// 并按场景脚本定时切换，方便在没有真实网络的情况下复现基准测试。
+// 只在主线程使用（命令处理与主循环）。
+class LinkImpairment
+{
+public:
+    explicit LinkImpairment(boost::asio::io_context &io_context);
+
+    void set(const Impairment &impairment, const std::vector<HSteamNetConnection> &connections);
+    const Impairment &current() const { return current_; }
+
+    bool runScenario(const std::string &path);
+    void stopScenario();
+    bool scenarioRunning() const { return !scenario_.steps().empty() && nextStep_ < scenario_.steps().size(); }
+    // Main loop: advances the running scenario
+    void update(const std::vector<HSteamNetConnection> &connections);
+
+    bool addProxy(unsigned short listenPort, const ForwardTarget &target, std::string &error);
+    void removeProxies();
+
+    void printStatus() const;
+
+private:
+    static void applyToSteam(const Impairment &impairment, const std::vector<HSteamNetConnection> &connections);
+
+    boost::asio::io_context &io_context_;
+    Impairment current_;
+    uint32_t seed_;
+    ImpairmentScenario scenario_;
+    size_t nextStep_;
+    std::chrono::steady_clock::time_point scenarioStart_;
+    std::vector<std::shared_ptr<ImpairmentProxy>> proxies_;
+};
+
+#endif // LINK_IMPAIRMENT_H
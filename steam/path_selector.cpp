@@ -0,0 +1,153 @@
+#include "path_selector.h"
+#include <algorithm>
+#include <isteamnetworkingutils.h>
+
+constexpr std::chrono::seconds PathSelector::kMinDwell;
+
+PathSelector::PathSelector()
+{
+}
+
+int PathSelector::p95(const std::deque<int> &samples)
+{
+    if (samples.size() < kMinSamples)
+    {
+        return -1;
+    }
+    std::vector<int> sorted(samples.begin(), samples.end());
+    size_t index = (sorted.size() * 95 + 99) / 100 - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+void PathSelector::setRemotePingLocation(CSteamID peer, const std::string &location)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    History &history = peers_[peer];
+    history.hasLocation = !location.empty() && SteamNetworkingUtils()->ParsePingLocationString(location.c_str(), history.location);
+    refreshEstimate(history);
+}
+
+void PathSelector::refreshEstimate(History &history)
+{
+    if (!history.hasLocation)
+    {
+        history.relayEstimateMs = -1;
+        return;
+    }
+    // Relay route estimate: both ends' pings to the nearest shared relay POPs
+    int estimate = SteamNetworkingUtils()->EstimatePingTimeFromLocalHost(history.location);
+    history.relayEstimateMs = estimate >= 0 ? estimate : -1;
+}
+
+void PathSelector::addSample(CSteamID peer, bool relayed, int pingMs)
+{
+    if (pingMs <= 0)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    History &history = peers_[peer];
+    std::deque<int> &samples = relayed ? history.relay : history.direct;
+    samples.push_back(pingMs);
+    if (samples.size() > kWindow)
+    {
+        samples.pop_front();
+    }
+    history.lastRelayed = relayed;
+}
+
+int PathSelector::relayP95(History &history)
+{
+    int measured = p95(history.relay);
+    if (measured >= 0)
+    {
+        return measured;
+    }
+    refreshEstimate(history); // our own ping location may have improved since
+    return history.relayEstimateMs;
+}
+
+bool PathSelector::otherPathBetter(History &history, bool relayed)
+{
+    int direct = p95(history.direct);
+    int relay = relayP95(history);
+    if (direct < 0 || relay < 0)
+    {
+        return false; // Nothing to compare against
+    }
+    int current = relayed ? relay : direct;
+    int other = relayed ? direct : relay;
+    return other + kMarginMs < current && other * 10 < current * 9;
+}
+
+bool PathSelector::preferRelay(CSteamID peer)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = peers_.find(peer);
+    if (it == peers_.end())
+    {
+        return false;
+    }
+    History &history = it->second;
+    // Stick with the last choice unless the other path is clearly better
+    if (otherPathBetter(history, history.preferRelay))
+    {
+        history.preferRelay = !history.preferRelay;
+        history.lastDecision = history.preferRelay ? "新连接走中继" : "新连接走直连";
+    }
+    return history.preferRelay;
+}
+
+bool PathSelector::shouldSwitch(CSteamID peer, bool relayed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = peers_.find(peer);
+    if (it == peers_.end())
+    {
+        return false;
+    }
+    History &history = it->second;
+    if (history.switches > 0 && std::chrono::steady_clock::now() - history.lastSwitch < kMinDwell)
+    {
+        return false;
+    }
+    if ((relayed ? history.relay : history.direct).size() < kMinSamples)
+    {
+        return false; // Not enough of the current path yet
+    }
+    if (!relayed && !otherPathBetter(history, false))
+    {
+        return false;
+    }
+    // On relay, only go back to direct when ICE was disabled by us; otherwise Steam already tried it
+    if (relayed && (!history.preferRelay || !otherPathBetter(history, true)))
+    {
+        return false;
+    }
+    return true;
+}
+
+void PathSelector::recordSwitch(CSteamID peer, bool toRelay)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    History &history = peers_[peer];
+    history.preferRelay = toRelay;
+    history.lastSwitch = std::chrono::steady_clock::now();
+    ++history.switches;
+    history.lastDecision = toRelay ? "切换到中继" : "切换到直连";
+}
+
+std::vector<PathStats> PathSelector::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PathStats> result;
+    for (const auto &pair : peers_)
+    {
+        const History &history = pair.second;
+        result.push_back(PathStats{pair.first, history.lastRelayed, p95(history.direct), p95(history.relay),
+                                   history.relayEstimateMs, history.direct.size(), history.relay.size(),
+                                   history.preferRelay, history.switches, history.lastDecision});
+    }
+    return result;
+}
@@ -0,0 +1,84 @@
+#ifndef PATH_SELECTOR_H
+#define PATH_SELECTOR_H
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <steam_api.h>
+#include <steamnetworkingtypes.h>
+
+enum class PathMode
+{
+    Default,    // Steam decides (ICE when it works, otherwise relay)
+    ForceRelay, // ICE disabled globally
+    Auto        // per host: whichever path has the lower p95 RTT
+};
+
+// Per-host path measurements (status output)
+struct PathStats
+{
+    CSteamID peer;
+    bool relayed;          // path of the most recent sample
+    int directP95Ms;       // -1 = not measured
+    int relayP95Ms;        // -1 = not measured
+    int relayEstimateMs;   // from ping locations, -1 = unknown
+    size_t directSamples;
+    size_t relaySamples;
+    bool preferRelay;
+    uint64_t switches;
+    std::string lastDecision;
+};
+
+// 自动选路：按主机分别记录直连 (ICE) 和中继 (SDR) 两条路径的 RTT 样本，
+// 中继路径没有实测时用双方 ping location 估算。某条路径的 p95 明显更低时，
+// 新连接改走该路径；已有连接在空闲时重连切换（由调用方执行）。
+class PathSelector
+{
+public:
+    PathSelector();
+
+    void setRemotePingLocation(CSteamID peer, const std::string &location);
+    void addSample(CSteamID peer, bool relayed, int pingMs);
+
+    // For a new connection to `peer`: disable ICE?
+    bool preferRelay(CSteamID peer);
+    // Whether a live connection on `relayed` path should move to the other path now
+    bool shouldSwitch(CSteamID peer, bool relayed);
+    void recordSwitch(CSteamID peer, bool toRelay);
+
+    std::vector<PathStats> getStats() const;
+
+private:
+    struct History
+    {
+        std::deque<int> direct;
+        std::deque<int> relay;
+        bool hasLocation = false;
+        SteamNetworkPingLocation_t location;
+        int relayEstimateMs = -1;
+        bool lastRelayed = false;
+        bool preferRelay = false;
+        uint64_t switches = 0;
+        std::chrono::steady_clock::time_point lastSwitch;
+        std::string lastDecision = "-";
+    };
+
+    static const size_t kWindow = 64;
+    static const size_t kMinSamples = 16;
+    static const int kMarginMs = 10;
+    static constexpr std::chrono::seconds kMinDwell{60};
+
+    static int p95(const std::deque<int> &samples);
+    void refreshEstimate(History &history);
+    int relayP95(History &history);
+    // Lower p95 on the other path by a clear margin? (requires mutex_)
+    bool otherPathBetter(History &history, bool relayed);
+
+    mutable std::mutex mutex_;
+    std::map<CSteamID, History> peers_;
+};
+
+#endif // PATH_SELECTOR_H
@@ -0,0 +1,121 @@
+#include "ping_location_cache.h"
+#include <fstream>
+#include <sstream>
+#include <isteamnetworkingutils.h>
+
+const char *const PingLocationCache::kDefaultFile = "ping_cache.txt";
+
+PingLocationCache::PingLocationCache(const std::string &path)
+    : path_(path)
+{
+}
+
+void PingLocationCache::load()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ifstream file(path_);
+    std::string line;
+    // Format: "local <location>" or "<host steamid> <location>", one per line
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        std::string location;
+        if (!(fields >> key) || !std::getline(fields >> std::ws, location) || location.empty())
+        {
+            continue;
+        }
+        if (key == "local")
+        {
+            local_ = location;
+            continue;
+        }
+        try
+        {
+            hosts_[std::stoull(key)] = location;
+        }
+        catch (const std::exception &)
+        {
+            // Skip malformed entries
+        }
+    }
+}
+
+void PingLocationCache::save()
+{
+    std::ofstream file(path_, std::ios::trunc);
+    if (!file)
+    {
+        return;
+    }
+    if (!local_.empty())
+    {
+        file << "local " << local_ << "\n";
+    }
+    for (const auto &pair : hosts_)
+    {
+        file << pair.first << " " << pair.second << "\n";
+    }
+}
+
+bool PingLocationCache::localLocation(SteamNetworkPingLocation_t &out, bool *measured)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool fresh = SteamNetworkingUtils()->GetLocalPingLocation(out) >= 0;
+    if (measured)
+    {
+        *measured = fresh;
+    }
+    if (fresh)
+    {
+        char text[k_cchMaxSteamNetworkingPingLocationString];
+        SteamNetworkingUtils()->ConvertPingLocationToString(out, text, sizeof(text));
+        if (local_ != text)
+        {
+            local_ = text;
+            save();
+        }
+        return true;
+    }
+    return !local_.empty() && SteamNetworkingUtils()->ParsePingLocationString(local_.c_str(), out);
+}
+
+void PingLocationCache::rememberHost(CSteamID host, const std::string &location)
+{
+    if (!host.IsValid() || location.empty())
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = hosts_.find(host.ConvertToUint64());
+    if (it != hosts_.end() && it->second == location)
+    {
+        return;
+    }
+    if (it == hosts_.end() && hosts_.size() >= kMaxHosts)
+    {
+        hosts_.erase(hosts_.begin()); // Arbitrary eviction is fine for a hint cache
+    }
+    hosts_[host.ConvertToUint64()] = location;
+    save();
+}
+
+std::string PingLocationCache::hostLocation(CSteamID host) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = hosts_.find(host.ConvertToUint64());
+    return it != hosts_.end() ? it->second : std::string();
+}
+
+int PingLocationCache::estimatePing(const std::string &remoteLocation)
+{
+    SteamNetworkPingLocation_t local;
+    SteamNetworkPingLocation_t remote;
+    if (remoteLocation.empty() || !SteamNetworkingUtils()->ParsePingLocationString(remoteLocation.c_str(), remote) ||
+        !localLocation(local))
+    {
+        return -1;
+    }
+    int ping = SteamNetworkingUtils()->EstimatePingTimeBetweenTwoLocations(local, remote);
+    return ping >= 0 ? ping : -1;
+}
@@ -0,0 +1,41 @@
+#ifndef PING_LOCATION_CACHE_H
+#define PING_LOCATION_CACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <steam_api.h>
+#include <steamnetworkingtypes.h>
+
+// ping location 缓存：本机位置要在中继网络测速完成后（启动后数秒）才可用，
+// 把上次的结果和见过的主机位置存到文件里，重启后大厅列表可以立即按延迟排序。
+class PingLocationCache
+{
+public:
+    static const char *const kDefaultFile;
+
+    explicit PingLocationCache(const std::string &path = kDefaultFile);
+
+    void load();
+
+    // Fresh location from Steam when measured (and then persisted), otherwise the cached one;
+    // `measured` tells which of the two it was
+    bool localLocation(SteamNetworkPingLocation_t &out, bool *measured = nullptr);
+    void rememberHost(CSteamID host, const std::string &location);
+    std::string hostLocation(CSteamID host) const;
+
+    // Predicted round trip from us to `remoteLocation` through the relay network, -1 if unknown
+    int estimatePing(const std::string &remoteLocation);
+
+private:
+    static const size_t kMaxHosts = 128;
+
+    void save(); // requires mutex_
+
+    std::string path_;
+    mutable std::mutex mutex_;
+    std::string local_;
+    std::map<uint64, std::string> hosts_;
+};
+
+#endif // PING_LOCATION_CACHE_H
@@ -0,0 +1,154 @@
+#include "send_rate_controller.h"
+#include <algorithm>
+#include <isteamnetworkingutils.h>
+
+constexpr std::chrono::milliseconds SendRateController::kInterval;
+constexpr std::chrono::seconds SendRateController::kBaseRttWindow;
+
+SendRateController::SendRateController(ISteamNetworkingSockets *sockets)
+    : sockets_(sockets)
+{
+}
+
+void SendRateController::update(const std::vector<HSteamNetConnection> &connections)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now - lastUpdate_ < kInterval)
+    {
+        return;
+    }
+    lastUpdate_ = now;
+    for (auto conn : connections)
+    {
+        auto it = states_.find(conn);
+        if (it == states_.end())
+        {
+            State state;
+            state.stats = RateControlStats{conn, kInitialRate, 0, 0, 0, 0, 0, 1.0f, '=', "初始", 0, 0};
+            state.baseRttSince = now;
+            it = states_.emplace(conn, state).first;
+            apply(conn, it->second);
+        }
+        sample(conn, it->second);
+    }
+}
+
+void SendRateController::forget(HSteamNetConnection conn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    states_.erase(conn);
+}
+
+void SendRateController::setCeiling(HSteamNetConnection conn, int ceiling)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = states_.find(conn);
+    if (it == states_.end())
+    {
+        State state;
+        state.stats = RateControlStats{conn, kInitialRate, 0, 0, 0, 0, 0, 1.0f, '=', "初始", 0, 0};
+        state.baseRttSince = std::chrono::steady_clock::now();
+        it = states_.emplace(conn, state).first;
+    }
+    it->second.stats.ceiling = std::max(ceiling, 0);
+    apply(conn, it->second);
+}
+
+void SendRateController::sample(HSteamNetConnection conn, State &state)
+{
+    SteamNetConnectionRealTimeStatus_t status;
+    if (sockets_->GetConnectionRealTimeStatus(conn, &status, 0, nullptr) != k_EResultOK ||
+        status.m_eState != k_ESteamNetworkingConnectionState_Connected || status.m_nPing <= 0)
+    {
+        return;
+    }
+    RateControlStats &stats = state.stats;
+    auto now = std::chrono::steady_clock::now();
+
+    // Base RTT: minimum over a sliding window so a route change can raise it again
+    if (stats.baseRttMs == 0 || status.m_nPing < stats.baseRttMs)
+    {
+        stats.baseRttMs = status.m_nPing;
+    }
+    if (state.nextBaseRttMs == 0 || status.m_nPing < state.nextBaseRttMs)
+    {
+        state.nextBaseRttMs = status.m_nPing;
+    }
+    if (now - state.baseRttSince >= kBaseRttWindow)
+    {
+        stats.baseRttMs = state.nextBaseRttMs;
+        state.nextBaseRttMs = 0;
+        state.baseRttSince = now;
+    }
+
+    state.srttMs = state.srttMs == 0.0 ? status.m_nPing : state.srttMs * 0.75 + status.m_nPing * 0.25;
+    stats.smoothedRttMs = static_cast<int>(state.srttMs);
+    stats.queueDelayMs = std::max(0, stats.smoothedRttMs - stats.baseRttMs);
+    stats.pendingBytes = status.m_cbPendingReliable + status.m_cbPendingUnreliable;
+    stats.quality = status.m_flConnectionQualityLocal;
+    int localQueueMs = static_cast<int>(status.m_usecQueueTime / 1000);
+
+    int rate = stats.rate;
+    if (stats.quality >= 0 && stats.quality < 0.95f)
+    {
+        rate = static_cast<int>(rate * 0.8);
+        stats.lastAction = '-';
+        stats.lastReason = "丢包";
+    }
+    else if (stats.queueDelayMs > 2 * kTargetQueueDelayMs)
+    {
+        rate = static_cast<int>(rate * 0.85);
+        stats.lastAction = '-';
+        stats.lastReason = "时延上升";
+    }
+    else if (stats.queueDelayMs < kTargetQueueDelayMs && (localQueueMs > 20 || stats.pendingBytes > rate / 20))
+    {
+        // Path is not queueing but we are holding data back: we are the bottleneck
+        rate += std::max(rate / 8, kMinRate);
+        stats.lastAction = '+';
+        stats.lastReason = "有积压且时延低";
+    }
+    else
+    {
+        stats.lastAction = '=';
+        stats.lastReason = stats.queueDelayMs < kTargetQueueDelayMs ? "无积压" : "接近目标时延";
+    }
+    rate = std::min(std::max(rate, kMinRate), stats.ceiling > 0 ? std::max(stats.ceiling, kMinRate) : kMaxRate);
+    if (rate > stats.rate)
+    {
+        ++stats.increases;
+    }
+    else if (rate < stats.rate)
+    {
+        ++stats.decreases;
+    }
+    if (rate != stats.rate)
+    {
+        stats.rate = rate;
+        apply(conn, state);
+    }
+}
+
+void SendRateController::apply(HSteamNetConnection conn, State &state)
+{
+    int rate = state.stats.rate;
+    if (state.stats.ceiling > 0)
+    {
+        rate = std::min(rate, state.stats.ceiling);
+    }
+    // Max is our target; Steam's own estimator may still back off down to half of it
+    SteamNetworkingUtils()->SetConnectionConfigValueInt32(conn, k_ESteamNetworkingConfig_SendRateMax, rate);
+    SteamNetworkingUtils()->SetConnectionConfigValueInt32(conn, k_ESteamNetworkingConfig_SendRateMin, std::max(rate / 2, std::min(rate, kMinRate)));
+}
+
+std::vector<RateControlStats> SendRateController::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<RateControlStats> result;
+    for (const auto &pair : states_)
+    {
+        result.push_back(pair.second.stats);
+    }
+    return result;
+}
@@ -0,0 +1,72 @@
+#ifndef SEND_RATE_CONTROLLER_H
+#define SEND_RATE_CONTROLLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <steam_api.h>
+#include <isteamnetworkingsockets.h>
+#include <steamnetworkingtypes.h>
+
+// Last decision and inputs for one connection (status output)
+struct RateControlStats
+{
+    HSteamNetConnection connection;
+    int rate;              // current SendRateMax (bytes/s)
+    int ceiling;           // external cap, e.g. admission budget share (0 = none)
+    int baseRttMs;         // windowed minimum ping
+    int smoothedRttMs;
+    int queueDelayMs;      // smoothed ping above base: queue building up on the path
+    int pendingBytes;      // reliable + unreliable bytes waiting in Steam's send queue
+    float quality;         // local connection quality (1 = no loss)
+    char lastAction;       // '+' increase, '-' decrease, '=' hold
+    const char *lastReason;
+    uint64_t increases;
+    uint64_t decreases;
+};
+
+// 每连接的发送速率控制器：以排队时延为目标（类似 LEDBAT），
+// 排队时延低且有数据待发时加性增大，时延超标、丢包或本地积压时乘性减小，
+// 结果写入该连接的 SendRateMax/SendRateMin，让 Steam 在这个区间内自行调节。
+class SendRateController
+{
+public:
+    static const int kMinRate = 64 * 1024;
+    static const int kMaxRate = 64 * 1024 * 1024;
+    static const int kInitialRate = 5 * 1024 * 1024;
+
+    explicit SendRateController(ISteamNetworkingSockets *sockets);
+
+    // Samples every connection at most once per kInterval and adjusts its rate
+    void update(const std::vector<HSteamNetConnection> &connections);
+    void forget(HSteamNetConnection conn);
+    // Hard cap for one connection (0 = none); applied immediately
+    void setCeiling(HSteamNetConnection conn, int ceiling);
+
+    std::vector<RateControlStats> getStats() const;
+
+private:
+    struct State
+    {
+        RateControlStats stats;
+        double srttMs = 0.0;
+        std::chrono::steady_clock::time_point baseRttSince;
+        int nextBaseRttMs = 0; // minimum seen in the current window, becomes base when it expires
+    };
+
+    static constexpr std::chrono::milliseconds kInterval{500};
+    static constexpr std::chrono::seconds kBaseRttWindow{10};
+    static const int kTargetQueueDelayMs = 25;
+
+    void sample(HSteamNetConnection conn, State &state);
+    void apply(HSteamNetConnection conn, State &state);
+
+    ISteamNetworkingSockets *sockets_;
+    mutable std::mutex mutex_;
+    std::map<HSteamNetConnection, State> states_;
+    std::chrono::steady_clock::time_point lastUpdate_;
+};
+
+#endif // SEND_RATE_CONTROLLER_H
@@ -0,0 +1,88 @@
+#include "startup_milestones.h"
+#include "steam_networking_manager.h"
+#include <iostream>
+#include <sstream>
+
+StartupMilestones::StartupMilestones()
+    : start_(std::chrono::steady_clock::now()), lastPoll_(start_)
+{
+    elapsedMs_.fill(-1);
+}
+
+const char *StartupMilestones::name(Milestone milestone)
+{
+    switch (milestone)
+    {
+    case ApiUp: return "Steam API";
+    case ManagerReady: return "网络模块";
+    case RelayAvailable: return "中继网络";
+    case PingLocationValid: return "Ping 位置";
+    case FirstConnection: return "首个连接";
+    default: return "?";
+    }
+}
+
+void StartupMilestones::mark(Milestone milestone)
+{
+    if (reached(milestone))
+    {
+        return;
+    }
+    elapsedMs_[milestone] = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_).count();
+    std::cout << "[启动] " << name(milestone) << " 就绪：+" << elapsedMs_[milestone] << " ms\033[K\n";
+}
+
+void StartupMilestones::poll(const SteamNetworkingManager &manager)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastPoll_ < std::chrono::milliseconds(100))
+    {
+        return;
+    }
+    lastPoll_ = now;
+    if (!reached(RelayAvailable))
+    {
+        SteamRelayNetworkStatus_t status;
+        if (SteamNetworkingUtils()->GetRelayNetworkStatus(&status) == k_ESteamNetworkingAvailability_Current)
+        {
+            mark(RelayAvailable);
+        }
+    }
+    if (!reached(PingLocationValid))
+    {
+        SteamNetworkPingLocation_t location;
+        if (SteamNetworkingUtils()->GetLocalPingLocation(location) >= 0)
+        {
+            mark(PingLocationValid);
+        }
+    }
+    if (!reached(FirstConnection))
+    {
+        for (auto conn : manager.getConnections())
+        {
+            if (manager.isConnectionReady(conn))
+            {
+                mark(FirstConnection);
+                break;
+            }
+        }
+    }
+}
+
+std::string StartupMilestones::summary() const
+{
+    std::ostringstream out;
+    for (int i = 0; i < kCount; ++i)
+    {
+        out << (i ? " | " : "") << name(static_cast<Milestone>(i)) << " ";
+        if (elapsedMs_[i] >= 0)
+        {
+            out << elapsedMs_[i] << " ms";
+        }
+        else
+        {
+            out << "-";
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,41 @@
+#ifndef STARTUP_MILESTONES_H
+#define STARTUP_MILESTONES_H
+
+#include <array>
+#include <chrono>
+#include <string>
+
+class SteamNetworkingManager;
+
+// 启动耗时埋点：记录从进程启动到各个就绪阶段的时间，
+// 用来确认中继网络和 ping location 的预热是否赶在用户第一次 join 之前完成。
+class StartupMilestones
+{
+public:
+    enum Milestone
+    {
+        ApiUp,             // SteamAPI_Init returned
+        ManagerReady,      // networking manager initialized, commands accepted
+        RelayAvailable,    // relay network status is Current
+        PingLocationValid, // local ping location measured
+        FirstConnection,   // first P2P connection reached Connected
+        kCount
+    };
+
+    StartupMilestones();
+
+    void mark(Milestone milestone);
+    // Main loop: checks the asynchronous milestones (cheap once all are reached)
+    void poll(const SteamNetworkingManager &manager);
+    bool reached(Milestone milestone) const { return elapsedMs_[milestone] >= 0; }
+    std::string summary() const;
+
+private:
+    static const char *name(Milestone milestone);
+
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point lastPoll_;
+    std::array<long long, kCount> elapsedMs_;
+};
+
+#endif // STARTUP_MILESTONES_H
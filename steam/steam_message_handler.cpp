@@ -2,11 +2,21 @@
 #include <iostream>
 #include <cstring>
 #include <chrono>
+#include <algorithm>
 #include <steam_api.h>
 #include <isteamnetworkingsockets.h>
 
-SteamMessageHandler::SteamMessageHandler(boost::asio::io_context& io_context, ISteamNetworkingSockets* interface, std::vector<HSteamNetConnection>& connections, std::mutex& connectionsMutex, bool& g_isHost, int& localPort)
-    : io_context_(io_context), m_pInterface_(interface), connections_(connections), connectionsMutex_(connectionsMutex), g_isHost_(g_isHost), localPort_(localPort), running_(false), currentPollInterval_(0) {}
+SteamMessageHandler::SteamMessageHandler(boost::asio::io_context& io_context, ISteamNetworkingSockets* interface, std::vector<HSteamNetConnection>& connections, std::mutex& connectionsMutex, bool& g_isHost, ForwardTargetList& targets)
+    : io_context_(io_context), m_pInterface_(interface), connections_(connections), connectionsMutex_(connectionsMutex), g_isHost_(g_isHost), targets_(targets),
+      connectionPool_(std::make_shared<LocalConnectionPool>(io_context, targets)), trafficShaper_(std::make_shared<TrafficShaper>()),
+      memoryBudget_(std::make_shared<MemoryBudget>()), capture_(std::make_shared<TrafficCapture>()),
+      maxStreamsPerPeer_(0), budgetYields_(0), maxBatchSize_(kMinBatch), running_(false), currentPollInterval_(0) {
+    for (auto& bucket : batchHistogram_) {
+        bucket = 0;
+    }
+}
+
+constexpr std::chrono::microseconds SteamMessageHandler::kDrainBudget;
 
 SteamMessageHandler::~SteamMessageHandler() {
     stop();
@@ -28,10 +38,52 @@ void SteamMessageHandler::stop() {
 }
 
 std::shared_ptr<MultiplexManager> SteamMessageHandler::getMultiplexManager(HSteamNetConnection conn) {
-    if (multiplexManagers_.find(conn) == multiplexManagers_.end()) {
-        multiplexManagers_[conn] = std::make_shared<MultiplexManager>(m_pInterface_, conn, io_context_, g_isHost_, localPort_);
+    std::lock_guard<std::mutex> lock(managersMutex_);
+    auto it = multiplexManagers_.find(conn);
+    if (it != multiplexManagers_.end()) {
+        return it->second;
+    }
+    auto manager = createMultiplexManager(conn);
+    // A late caller for a closed connection gets a throwaway manager, so the entry is not leaked
+    if (closedConnections_.count(conn) == 0) {
+        multiplexManagers_[conn] = manager;
+    }
+    return manager;
+}
+
+void SteamMessageHandler::removeMultiplexManager(HSteamNetConnection conn) {
+    std::shared_ptr<MultiplexManager> manager;
+    {
+        std::lock_guard<std::mutex> lock(managersMutex_);
+        auto it = multiplexManagers_.find(conn);
+        if (it != multiplexManagers_.end()) {
+            manager = std::move(it->second);
+            multiplexManagers_.erase(it);
+        }
+        closedConnections_.insert(conn);
+        if (closedConnections_.size() > kMaxClosedConnections) {
+            closedConnections_.erase(closedConnections_.begin()); // Handles only grow, drop the oldest
+        }
+    }
+    if (manager) {
+        // Tear down on the io thread: closes the local sockets, runs their close hooks
+        // and returns the buffers to the memory budget
+        boost::asio::post(io_context_, [manager]() mutable { manager.reset(); });
+    }
+}
+
+std::shared_ptr<MultiplexManager> SteamMessageHandler::createMultiplexManager(HSteamNetConnection conn) {
+    auto manager = std::make_shared<MultiplexManager>(m_pInterface_, conn, io_context_, g_isHost_, targets_, connectionPool_, trafficShaper_, memoryBudget_, capture_);
+    manager->setMaxStreams(static_cast<size_t>(maxStreamsPerPeer_.load()));
+    return manager;
+}
+
+void SteamMessageHandler::setMaxStreamsPerPeer(int maxStreams) {
+    maxStreamsPerPeer_ = std::max(maxStreams, 0);
+    std::lock_guard<std::mutex> lock(managersMutex_);
+    for (auto& pair : multiplexManagers_) {
+        pair.second->setMaxStreams(static_cast<size_t>(maxStreamsPerPeer_.load()));
     }
-    return multiplexManagers_[conn];
 }
 
 void SteamMessageHandler::startAsyncPoll() {
@@ -48,22 +100,32 @@ void SteamMessageHandler::startAsyncPoll() {
         std::lock_guard<std::mutex> lockConn(connectionsMutex_);
         currentConnections = connections_;
     }
+    // Drain each connection until it is empty, but yield once the budget is spent:
+    // host-side local writes and reads run on this same io_context
+    auto deadline = std::chrono::steady_clock::now() + kDrainBudget;
+    bool budgetExhausted = false;
     for (auto conn : currentConnections) {
-        ISteamNetworkingMessage* pIncomingMsgs[64];  // Increased to 64 for better throughput
-        int numMsgs = m_pInterface_->ReceiveMessagesOnConnection(conn, pIncomingMsgs, 64);
-        totalMessages += numMsgs;
-        for (int i = 0; i < numMsgs; ++i) {
-            ISteamNetworkingMessage* pIncomingMsg = pIncomingMsgs[i];
-            const char* data = (const char*)pIncomingMsg->m_pData;
-            size_t size = pIncomingMsg->m_cbSize;
-            // Handle tunnel packets with multiplexing
-            if (multiplexManagers_.find(conn) == multiplexManagers_.end()) {
-                multiplexManagers_[conn] = std::make_shared<MultiplexManager>(m_pInterface_, conn, io_context_, g_isHost_, localPort_);
+        totalMessages += drainConnection(conn, deadline, budgetExhausted);
+    }
+    if (budgetExhausted) {
+        ++budgetYields_;
+    }
+    if (batchSizes_.size() > currentConnections.size()) {
+        for (auto it = batchSizes_.begin(); it != batchSizes_.end();) {
+            if (std::find(currentConnections.begin(), currentConnections.end(), it->first) == currentConnections.end()) {
+                it = batchSizes_.erase(it);
+            } else {
+                ++it;
             }
-            multiplexManagers_[conn]->handleTunnelPacket(data, size);
-            pIncomingMsg->Release();
         }
     }
+    refreshSteamPending(currentConnections);
+
+    int maxBatch = kMinBatch;
+    for (const auto& pair : batchSizes_) {
+        maxBatch = std::max(maxBatch, pair.second);
+    }
+    maxBatchSize_ = maxBatch;
     
     // Adaptive polling: if messages received, poll immediately; otherwise increase interval
     if (totalMessages > 0) {
@@ -82,3 +144,77 @@ void SteamMessageHandler::startAsyncPoll() {
     });
 }
 
+int SteamMessageHandler::drainConnection(HSteamNetConnection conn, std::chrono::steady_clock::time_point deadline, bool& budgetExhausted) {
+    auto manager = getMultiplexManager(conn);
+    auto inserted = batchSizes_.emplace(conn, kMinBatch);
+    int& batchSize = inserted.first->second;
+    int received = 0;
+    while (true) {
+        if (manager->inboundBacklogged() || memoryBudget_->shouldPauseReceive()) {
+            // Local sockets are not keeping up (or inbound memory is spent): leave messages
+            // with Steam so the peer's reliable window fills and it slows down
+            break;
+        }
+        int numMsgs = m_pInterface_->ReceiveMessagesOnConnection(conn, incoming_.data(), batchSize);
+        if (numMsgs <= 0) {
+            break;
+        }
+        recordBatch(numMsgs);
+        received += numMsgs;
+        for (int i = 0; i < numMsgs; ++i) {
+            // The manager owns each message until its payload has been written locally
+            manager->handleTunnelMessage(SteamMessagePtr(incoming_[i]));
+        }
+        manager->flushInbound();
+
+        bool full = numMsgs == batchSize;
+        if (full) {
+            batchSize = std::min(batchSize * 2, kMaxBatch);
+        } else if (numMsgs < batchSize / 4) {
+            batchSize = std::max(batchSize / 2, kMinBatch);
+        }
+        if (!full) {
+            break; // Drained
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            budgetExhausted = true;
+            break;
+        }
+    }
+    return received;
+}
+
+void SteamMessageHandler::refreshSteamPending(const std::vector<HSteamNetConnection>& connections) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastPendingRefresh_ < std::chrono::milliseconds(100)) {
+        return;
+    }
+    lastPendingRefresh_ = now;
+    // Steam's send buffers count against the budget too: local reads and new streams pause until they drain
+    size_t pending = 0;
+    for (auto conn : connections) {
+        SteamNetConnectionRealTimeStatus_t status;
+        if (m_pInterface_->GetConnectionRealTimeStatus(conn, &status, 0, nullptr) == k_EResultOK) {
+            pending += static_cast<size_t>(status.m_cbPendingReliable + status.m_cbPendingUnreliable + status.m_cbSentUnackedReliable);
+        }
+    }
+    memoryBudget_->setSteamPending(pending);
+}
+
+void SteamMessageHandler::recordBatch(int numMsgs) {
+    int bucket = 0;
+    while ((2 << bucket) <= numMsgs && bucket < ReceiveStats::kBuckets - 1) {
+        ++bucket;
+    }
+    ++batchHistogram_[bucket];
+}
+
+ReceiveStats SteamMessageHandler::getReceiveStats() const {
+    ReceiveStats stats;
+    for (int i = 0; i < ReceiveStats::kBuckets; ++i) {
+        stats.histogram[i] = batchHistogram_[i];
+    }
+    stats.budgetYields = budgetYields_;
+    stats.maxBatchSize = maxBatchSize_;
+    return stats;
+}
@@ -3,35 +3,80 @@
 
 #include <vector>
 #include <map>
+#include <set>
 #include <mutex>
 #include <thread>
 #include <memory>
+#include <atomic>
+#include <array>
 #include <boost/asio.hpp>
 #include <steamnetworkingtypes.h>
 #include "../net/tcp_server.h"
 #include "../net/multiplex_manager.h"
 
+// 接收批次统计：每次 ReceiveMessagesOnConnection 取到的消息数分布
+struct ReceiveStats {
+    static const int kBuckets = 9; // 1, 2-3, 4-7, ... 128-255, 256+
+    std::array<uint64_t, kBuckets> histogram;
+    uint64_t budgetYields; // 积压未取完但时间片用尽，让出给本地 I/O
+    int maxBatchSize;      // 当前各连接中最大的批大小
+};
+
 class SteamMessageHandler {
 public:
-    SteamMessageHandler(boost::asio::io_context& io_context, ISteamNetworkingSockets* interface, std::vector<HSteamNetConnection>& connections, std::mutex& connectionsMutex, bool& g_isHost, int& localPort);
+    SteamMessageHandler(boost::asio::io_context& io_context, ISteamNetworkingSockets* interface, std::vector<HSteamNetConnection>& connections, std::mutex& connectionsMutex, bool& g_isHost, ForwardTargetList& targets);
     ~SteamMessageHandler();
 
     void start();
     void stop();
 
     std::shared_ptr<MultiplexManager> getMultiplexManager(HSteamNetConnection conn);
+    // Connection closed: drop its manager, closing the local streams and freeing their buffers
+    void removeMultiplexManager(HSteamNetConnection conn);
+    std::shared_ptr<LocalConnectionPool> getConnectionPool() { return connectionPool_; }
+    std::shared_ptr<TrafficShaper> getTrafficShaper() { return trafficShaper_; }
+    std::shared_ptr<MemoryBudget> getMemoryBudget() { return memoryBudget_; }
+    std::shared_ptr<TrafficCapture> getTrafficCapture() { return capture_; }
+    void setMaxStreamsPerPeer(int maxStreams); // 0 = unlimited, applies to existing peers too
+    ReceiveStats getReceiveStats() const;
 
 private:
     void startAsyncPoll();
+    std::shared_ptr<MultiplexManager> createMultiplexManager(HSteamNetConnection conn); // requires managersMutex_
+    void refreshSteamPending(const std::vector<HSteamNetConnection>& connections);
+    // Receives until a short batch, a backlog or the time budget; returns messages received
+    int drainConnection(HSteamNetConnection conn, std::chrono::steady_clock::time_point deadline, bool& budgetExhausted);
+    void recordBatch(int numMsgs);
+
+    // Adaptive batch size per connection: doubles while batches come back full,
+    // halves when they come back mostly empty
+    static const int kMinBatch = 16;
+    static const int kMaxBatch = 256;
+    static constexpr std::chrono::microseconds kDrainBudget{2000};
 
     boost::asio::io_context& io_context_;
     ISteamNetworkingSockets* m_pInterface_;
     std::vector<HSteamNetConnection>& connections_;
     std::mutex& connectionsMutex_;
     bool& g_isHost_;
-    int& localPort_;
+    ForwardTargetList& targets_;
 
+    static const size_t kMaxClosedConnections = 1024;
+    std::mutex managersMutex_; // poll loop, TCP server thread and status output all look up managers
     std::map<HSteamNetConnection, std::shared_ptr<MultiplexManager>> multiplexManagers_;
+    std::set<HSteamNetConnection> closedConnections_;
+    std::shared_ptr<LocalConnectionPool> connectionPool_; // 主持端预连接池，所有对端共享
+    std::shared_ptr<TrafficShaper> trafficShaper_;        // 限速配置与服务级令牌桶，所有对端共享
+    std::shared_ptr<MemoryBudget> memoryBudget_;          // 全局内存预算，所有对端共享
+    std::shared_ptr<TrafficCapture> capture_;             // 流量捕获，所有对端写同一个文件
+    std::atomic<int> maxStreamsPerPeer_;
+
+    std::map<HSteamNetConnection, int> batchSizes_; // poll thread only
+    std::array<ISteamNetworkingMessage*, kMaxBatch> incoming_;
+    std::array<std::atomic<uint64_t>, ReceiveStats::kBuckets> batchHistogram_;
+    std::atomic<uint64_t> budgetYields_;
+    std::atomic<int> maxBatchSize_;
+    std::chrono::steady_clock::time_point lastPendingRefresh_;
 
     std::unique_ptr<boost::asio::steady_timer> timer_;
     bool running_;
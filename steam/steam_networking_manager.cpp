@@ -2,9 +2,13 @@
 #include <iostream>
 #include <algorithm>
 #include <sstream>
+#include <climits>
 
 SteamNetworkingManager *SteamNetworkingManager::instance = nullptr;
 
+// Ping data younger than this is trusted at startup instead of re-measuring every relay POP
+static const float kPingDataMaxAgeSeconds = 600.0f;
+
 // STEAM_CALLBACK 回调函数 - 当连接状态改变时由 SteamAPI_RunCallbacks() 调用
 void SteamNetworkingManager::OnSteamNetConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t *pCallback)
 {
@@ -14,7 +18,7 @@ void SteamNetworkingManager::OnSteamNetConnectionStatusChanged(SteamNetConnectio
 SteamNetworkingManager::SteamNetworkingManager()
     : m_pInterface(nullptr), hListenSock(k_HSteamListenSocket_Invalid), g_isHost(false), g_isClient(false), g_isConnected(false),
       g_hConnection(k_HSteamNetConnection_Invalid),
-      io_context_(nullptr), server_(nullptr), localPort_(nullptr), messageHandler_(nullptr), hostPing_(0)
+      io_context_(nullptr), forwardTargets_(nullptr), messageHandler_(nullptr), hostPing_(0), pathMode_(PathMode::Default)
 {
 }
 
@@ -65,22 +69,6 @@ bool SteamNetworkingManager::initialize()
     //     k_ESteamNetworkingConfig_Int32,
     //     &symmetricConnect);
 
-    // 2. 增加连接超时时间，提高稳定性
-    int32 timeoutMs = 30000; // 30秒
-    SteamNetworkingUtils()->SetConfigValue(
-        k_ESteamNetworkingConfig_TimeoutInitial,
-        k_ESteamNetworkingConfig_Global,
-        0,
-        k_ESteamNetworkingConfig_Int32,
-        &timeoutMs);
-    
-    SteamNetworkingUtils()->SetConfigValue(
-        k_ESteamNetworkingConfig_TimeoutConnected,
-        k_ESteamNetworkingConfig_Global,
-        0,
-        k_ESteamNetworkingConfig_Int32,
-        &timeoutMs);
-
     // Allow connections from IPs without authentication
     int32 allowWithoutAuth = 2;
     SteamNetworkingUtils()->SetConfigValue(
@@ -92,57 +80,38 @@ bool SteamNetworkingManager::initialize()
 
     // ============ Performance Optimization (Reference: ConnectTool-tun) ============
     
-    // 1. Disable Nagle's algorithm for lower latency
-    int32 nagleTime = 0;
-    SteamNetworkingUtils()->SetConfigValue(
-        k_ESteamNetworkingConfig_NagleTime,
-        k_ESteamNetworkingConfig_Global,
-        0,
-        k_ESteamNetworkingConfig_Int32,
-        &nagleTime);
-
-    // 2. Increase Send Rate (5MB/s) to handle large Minecraft chunks
-    int32 sendRate = 5 * 1024 * 1024; 
+    // 1. Starting send rate window; SendRateController then adapts each connection's min/max
+    int32 sendRateMin = SendRateController::kInitialRate / 2;
+    int32 sendRateMax = SendRateController::kInitialRate;
     SteamNetworkingUtils()->SetConfigValue(
         k_ESteamNetworkingConfig_SendRateMin,
         k_ESteamNetworkingConfig_Global,
         0,
         k_ESteamNetworkingConfig_Int32,
-        &sendRate);
+        &sendRateMin);
     SteamNetworkingUtils()->SetConfigValue(
         k_ESteamNetworkingConfig_SendRateMax,
         k_ESteamNetworkingConfig_Global,
         0,
         k_ESteamNetworkingConfig_Int32,
-        &sendRate);
+        &sendRateMax);
 
-    // 3. Increase Send Buffer (10MB)
-    int32 sendBufferSize = 10 * 1024 * 1024;
-    SteamNetworkingUtils()->SetConfigValue(
-        k_ESteamNetworkingConfig_SendBufferSize,
-        k_ESteamNetworkingConfig_Global,
-        0,
-        k_ESteamNetworkingConfig_Int32,
-        &sendBufferSize);
-
-    // 4. Optimize MTU (Safe default for UDP tunneling)
-    int32 mtu = 1200;
-    SteamNetworkingUtils()->SetConfigValue(
-        k_ESteamNetworkingConfig_MTU_PacketSize,
-        k_ESteamNetworkingConfig_Global,
-        0,
-        k_ESteamNetworkingConfig_Int32,
-        &mtu);
+    // 3. Timeouts, Nagle, send buffer and MTU come from the default tuning profile
+    //    (tuning_profiles.ini, or the built-in lowlatency profile); each connection can switch later
+    tuningProfiles_.loadFile(TuningProfiles::kDefaultFile);
+    defaultProfile_ = tuningProfiles_.defaultName();
+    TuningProfiles::applyGlobal(*tuningProfiles_.find(defaultProfile_));
 
-    std::cout << "[配置] 已应用高性能网络参数 (NoDelay, 5MB/s Rate, 10MB Buffer)" << std::endl;
+    std::cout << "[配置] 已应用网络参数 (调优配置 " << defaultProfile_ << ", 自适应发送速率)" << std::endl;
 
-    // Initialize relay network access
+    // Initialize relay network access (no-op when prewarmRelayNetwork already started it)
     SteamNetworkingUtils()->InitRelayNetworkAccess();
     // 注意：不再使用 SetGlobalCallback，而是使用 STEAM_CALLBACK 宏
     // STEAM_CALLBACK 会自动在 SteamAPI_RunCallbacks() 时调度回调
     std::cout << "[SteamNet] Using STEAM_CALLBACK for connection status changes" << std::endl;
 
     m_pInterface = SteamNetworkingSockets();
+    rateController_.reset(new SendRateController(m_pInterface));
 
     // Check if callbacks are registered
     std::cout << "Steam Networking Manager initialized successfully" << std::endl;
@@ -157,6 +126,12 @@ bool SteamNetworkingManager::initialize()
 
 void SteamNetworkingManager::setForceRelay(bool force)
 {
+    setPathMode(force ? PathMode::ForceRelay : PathMode::Default);
+}
+
+void SteamNetworkingManager::setPathMode(PathMode mode)
+{
+    bool force = mode == PathMode::ForceRelay;
     int32 iceEnable = force ? k_nSteamNetworkingConfig_P2P_Transport_ICE_Enable_Disable : (k_nSteamNetworkingConfig_P2P_Transport_ICE_Enable_Public | k_nSteamNetworkingConfig_P2P_Transport_ICE_Enable_Private);
     SteamNetworkingUtils()->SetConfigValue(
         k_ESteamNetworkingConfig_P2P_Transport_ICE_Enable,
@@ -164,8 +139,28 @@ void SteamNetworkingManager::setForceRelay(bool force)
         0,
         k_ESteamNetworkingConfig_Int32,
         &iceEnable);
-        
-    std::cout << (force ? "[配置] 已开启强制中继模式 (Force Relay)。" : "[配置] 已关闭强制中继模式 (Auto P2P)。") << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        pathMode_ = mode;
+    }
+
+    if (mode == PathMode::Auto)
+    {
+        std::cout << "[配置] 已开启自动选路：按 p95 延迟在直连和中继之间选择。" << std::endl;
+    }
+    else
+    {
+        std::cout << (force ? "[配置] 已开启强制中继模式 (Force Relay)。" : "[配置] 已关闭强制中继模式 (Auto P2P)。") << std::endl;
+    }
+}
+
+void SteamNetworkingManager::prewarmRelayNetwork()
+{
+    // Both calls only start asynchronous work inside Steam: fetching the relay config
+    // and pinging the relay POPs. Steam keeps the last measurement for a while, so a
+    // recent ping location (e.g. after a quick restart) is reused instead of re-measured.
+    SteamNetworkingUtils()->InitRelayNetworkAccess();
+    SteamNetworkingUtils()->CheckPingDataUpToDate(kPingDataMaxAgeSeconds);
 }
 
 void SteamNetworkingManager::printRelayStatus()
@@ -237,10 +232,25 @@ bool SteamNetworkingManager::joinHost(uint64 hostID)
     SteamNetworkingIdentity identity;
     identity.SetSteamID(hostSteamID);
 
-    g_hConnection = m_pInterface->ConnectP2P(identity, 0, 0, nullptr);
+    std::vector<SteamNetworkingConfigValue_t> options;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        bool relayOnly = pathMode_ == PathMode::Auto && pathSelector_.preferRelay(hostSteamID);
+        options = buildConnectOptions(relayOnly);
+    }
+    g_hConnection = m_pInterface->ConnectP2P(identity, 0, static_cast<int>(options.size()), options.data());
 
     if (g_hConnection != k_HSteamNetConnection_Invalid)
     {
+        {
+            // Poll it right away; with several hosts the receive loop serves every connection
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            if (std::find(connections.begin(), connections.end(), g_hConnection) == connections.end())
+            {
+                connections.push_back(g_hConnection);
+            }
+            connectionProfiles_[g_hConnection] = defaultProfile_;
+        }
         std::cout << "[客户端] 正在连接主机 " << hostSteamID.ConvertToUint64() << "...\033[K\n";
         return true;
     }
@@ -253,6 +263,7 @@ bool SteamNetworkingManager::joinHost(uint64 hostID)
 
 void SteamNetworkingManager::disconnect()
 {
+    closeHostSessions();
     std::lock_guard<std::mutex> lock(connectionsMutex);
     
     // Close client connection
@@ -266,8 +277,14 @@ void SteamNetworkingManager::disconnect()
     for (auto conn : connections)
     {
         m_pInterface->CloseConnection(conn, 0, nullptr, false);
+        releaseConnection(conn);
     }
     connections.clear();
+    for (auto conn : unacceptedPeers_)
+    {
+        m_pInterface->CloseConnection(conn, 0, nullptr, false);
+    }
+    unacceptedPeers_.clear();
     
     // Close listen socket
     if (hListenSock != k_HSteamListenSocket_Invalid)
@@ -285,12 +302,210 @@ void SteamNetworkingManager::disconnect()
     std::cout << "Disconnected from network" << std::endl;
 }
 
-void SteamNetworkingManager::setMessageHandlerDependencies(boost::asio::io_context &io_context, std::unique_ptr<TCPServer> &server, int &localPort)
+bool SteamNetworkingManager::openHostSession(CSteamID hostID, const std::vector<int> &ports)
+{
+    if (hasHostSession(hostID))
+    {
+        std::cout << "[客户端] 已连接到主机 " << hostID.ConvertToUint64() << "，忽略重复加入。\033[K\n";
+        return true;
+    }
+    if (!joinHost(hostID.ConvertToUint64()))
+    {
+        return false;
+    }
+    auto session = std::make_unique<HostSession>();
+    session->hostID = hostID;
+    session->connection = g_hConnection;
+    session->server = std::make_unique<TCPServer>(ports, this, hostID);
+    if (!session->server->start())
+    {
+        // Failed to start TCP server; the P2P connection stays up for a retry
+    }
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    hostSessions_.push_back(std::move(session));
+    return true;
+}
+
+void SteamNetworkingManager::closeHostSessions()
+{
+    // Stop servers outside the lock: their threads call back into getHostConnection()
+    std::vector<std::unique_ptr<HostSession>> sessions;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        sessions.swap(hostSessions_);
+    }
+    for (auto &session : sessions)
+    {
+        session->server->stop();
+        if (session->connection != k_HSteamNetConnection_Invalid)
+        {
+            m_pInterface->CloseConnection(session->connection, 0, nullptr, false);
+        }
+    }
+}
+
+bool SteamNetworkingManager::hasHostSession(CSteamID hostID) const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (const auto &session : hostSessions_)
+    {
+        if (session->hostID == hostID)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t SteamNetworkingManager::getHostSessionCount() const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    return hostSessions_.size();
+}
+
+std::vector<HostSessionInfo> SteamNetworkingManager::getHostSessions() const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    std::vector<HostSessionInfo> result;
+    for (const auto &session : hostSessions_)
+    {
+        result.push_back(HostSessionInfo{session->hostID, session->connection, session->server->getPorts(),
+                                         session->server->getClientCount(), session->server->getPendingStats()});
+    }
+    return result;
+}
+
+HSteamNetConnection SteamNetworkingManager::getHostConnection(CSteamID hostID) const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    for (const auto &session : hostSessions_)
+    {
+        if (session->hostID == hostID)
+        {
+            return session->connection;
+        }
+    }
+    return k_HSteamNetConnection_Invalid;
+}
+
+AdmissionPolicy SteamNetworkingManager::getAdmissionPolicy() const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    return admission_;
+}
+
+void SteamNetworkingManager::setAdmissionPolicy(const AdmissionPolicy &policy)
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    admission_ = policy;
+    admission_.lobbyCapacity = std::min(std::max(admission_.lobbyCapacity, 1), kMaxLobbyMembers);
+    if (messageHandler_)
+    {
+        messageHandler_->setMaxStreamsPerPeer(admission_.maxStreamsPerPeer);
+        messageHandler_->getMemoryBudget()->setLimit(static_cast<size_t>(std::max<int64>(admission_.memoryBudget, 0)));
+    }
+    if (g_isHost)
+    {
+        admitUnacceptedPeers();
+        applyBandwidthBudget();
+    }
+}
+
+size_t SteamNetworkingManager::getUnacceptedPeerCount() const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    return unacceptedPeers_.size();
+}
+
+int SteamNetworkingManager::getUnacceptedPeerTimeoutMs() const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    bool listening = hListenSock != k_HSteamListenSocket_Invalid;
+    int32 timeout = 0;
+    size_t size = sizeof(timeout);
+    ESteamNetworkingConfigDataType type;
+    ESteamNetworkingGetConfigValueResult result = SteamNetworkingUtils()->GetConfigValue(
+        k_ESteamNetworkingConfig_TimeoutInitial, listening ? k_ESteamNetworkingConfig_ListenSocket : k_ESteamNetworkingConfig_Global,
+        listening ? static_cast<intptr_t>(hListenSock) : 0, &type, &timeout, &size);
+    return result > 0 && type == k_ESteamNetworkingConfig_Int32 ? timeout : -1;
+}
+
+bool SteamNetworkingManager::canAdmitPeer() const
+{
+    size_t peers = connections.size();
+    if (admission_.maxPeers > 0 && peers >= static_cast<size_t>(admission_.maxPeers))
+    {
+        return false;
+    }
+    if (admission_.bandwidthBudget > 0 && admission_.bandwidthBudget / static_cast<int64>(peers + 1) < admission_.minPeerRate)
+    {
+        return false;
+    }
+    return true;
+}
+
+void SteamNetworkingManager::admitPeer(HSteamNetConnection conn)
+{
+    m_pInterface->AcceptConnection(conn); // options were inherited from the listen socket
+    // The listen socket keeps the profile it was created with; follow a later 'profile' change
+    connectionProfiles_[conn] = listenProfile_;
+    const TuningProfile *profile = tuningProfiles_.find(defaultProfile_);
+    if (defaultProfile_ != listenProfile_ && profile && TuningProfiles::applyToConnection(conn, *profile))
+    {
+        connectionProfiles_[conn] = defaultProfile_;
+    }
+    if (std::find(connections.begin(), connections.end(), conn) == connections.end())
+    {
+        connections.push_back(conn);
+    }
+    // Keep the first peer as the "current" connection instead of the newest
+    if (g_hConnection == k_HSteamNetConnection_Invalid)
+    {
+        g_hConnection = conn;
+    }
+    g_isConnected = true;
+    applyBandwidthBudget();
+}
+
+void SteamNetworkingManager::admitUnacceptedPeers()
+{
+    while (!unacceptedPeers_.empty() && canAdmitPeer())
+    {
+        HSteamNetConnection conn = unacceptedPeers_.front();
+        unacceptedPeers_.pop_front();
+        SteamNetConnectionInfo_t info;
+        if (!m_pInterface->GetConnectionInfo(conn, &info) || info.m_eState != k_ESteamNetworkingConnectionState_Connecting)
+        {
+            continue; // Gave up or timed out before a slot freed up
+        }
+        std::cout << "[主机] 有空位，接入之前未接受的对端 " << info.m_identityRemote.GetSteamID().ConvertToUint64() << "\033[K\n";
+        admitPeer(conn);
+    }
+}
+
+void SteamNetworkingManager::applyBandwidthBudget()
+{
+    if (!rateController_ || connections.empty())
+    {
+        return;
+    }
+    // Split the aggregate budget evenly; the rate controller keeps each peer at or below its share
+    int32 share = 0;
+    if (admission_.bandwidthBudget > 0)
+    {
+        share = static_cast<int32>(std::min<int64>(admission_.bandwidthBudget / static_cast<int64>(connections.size()), INT_MAX));
+    }
+    for (auto conn : connections)
+    {
+        rateController_->setCeiling(conn, share);
+    }
+}
+
+void SteamNetworkingManager::setMessageHandlerDependencies(boost::asio::io_context &io_context, ForwardTargetList &targets)
 {
     io_context_ = &io_context;
-    server_ = &server;
-    localPort_ = &localPort;
-    messageHandler_ = new SteamMessageHandler(io_context, m_pInterface, connections, connectionsMutex, g_isHost, localPort);
+    forwardTargets_ = &targets;
+    messageHandler_ = new SteamMessageHandler(io_context, m_pInterface, connections, connectionsMutex, g_isHost, targets);
 }
 
 void SteamNetworkingManager::startMessageHandler()
@@ -321,6 +536,172 @@ void SteamNetworkingManager::update()
             hostPing_ = status.m_nPing;
         }
     }
+    if (rateController_)
+    {
+        rateController_->update(connections);
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastPathSample_ >= std::chrono::seconds(1))
+    {
+        lastPathSample_ = now;
+        samplePaths();
+    }
+}
+
+std::vector<SteamNetworkingConfigValue_t> SteamNetworkingManager::buildConnectOptions(bool relayOnly) const
+{
+    const TuningProfile *profile = tuningProfiles_.find(defaultProfile_);
+    std::vector<SteamNetworkingConfigValue_t> options = profile ? profile->options() : std::vector<SteamNetworkingConfigValue_t>();
+    if (relayOnly)
+    {
+        SteamNetworkingConfigValue_t ice;
+        ice.SetInt32(k_ESteamNetworkingConfig_P2P_Transport_ICE_Enable, k_nSteamNetworkingConfig_P2P_Transport_ICE_Enable_Disable);
+        options.push_back(ice);
+    }
+    return options;
+}
+
+void SteamNetworkingManager::samplePaths()
+{
+    for (auto &session : hostSessions_)
+    {
+        SteamNetConnectionInfo_t info;
+        SteamNetConnectionRealTimeStatus_t status;
+        if (session->connection == k_HSteamNetConnection_Invalid ||
+            !m_pInterface->GetConnectionInfo(session->connection, &info) ||
+            info.m_eState != k_ESteamNetworkingConnectionState_Connected ||
+            m_pInterface->GetConnectionRealTimeStatus(session->connection, &status, 0, nullptr) != k_EResultOK)
+        {
+            continue;
+        }
+        bool relayed = (info.m_nFlags & k_nSteamNetworkConnectionInfoFlags_Relayed) != 0;
+        pathSelector_.addSample(session->hostID, relayed, status.m_nPing);
+        if (pathMode_ != PathMode::Auto || !pathSelector_.shouldSwitch(session->hostID, relayed))
+        {
+            continue;
+        }
+        // Only switch while no local client is using the tunnel; the listeners stay up throughout
+        if (session->server->getClientCount() > 0 || session->server->getPendingStats().queued > 0)
+        {
+            continue;
+        }
+        reconnectHostSession(*session, !relayed);
+    }
+}
+
+void SteamNetworkingManager::releaseConnection(HSteamNetConnection conn)
+{
+    connectionProfiles_.erase(conn);
+    if (rateController_)
+    {
+        rateController_->forget(conn);
+    }
+    if (messageHandler_)
+    {
+        messageHandler_->removeMultiplexManager(conn);
+    }
+}
+
+bool SteamNetworkingManager::reconnectHostSession(HostSession &session, bool relayOnly)
+{
+    std::cout << "[客户端] 主机 " << session.hostID.ConvertToUint64() << " 的"
+              << (relayOnly ? "中继路径更快，切换到中继" : "直连路径更快，切换到直连") << "\033[K\n";
+    pathSelector_.recordSwitch(session.hostID, relayOnly);
+
+    // Close first so the host sees one connection per client. No status callback arrives
+    // for a connection we close ourselves, so its bookkeeping is dropped here.
+    HSteamNetConnection old = session.connection;
+    m_pInterface->CloseConnection(old, 0, "path switch", false);
+    connections.erase(std::remove(connections.begin(), connections.end(), old), connections.end());
+    releaseConnection(old);
+    session.connection = k_HSteamNetConnection_Invalid;
+
+    SteamNetworkingIdentity identity;
+    identity.SetSteamID(session.hostID);
+    std::vector<SteamNetworkingConfigValue_t> options = buildConnectOptions(relayOnly);
+    HSteamNetConnection conn = m_pInterface->ConnectP2P(identity, 0, static_cast<int>(options.size()), options.data());
+    if (conn != k_HSteamNetConnection_Invalid)
+    {
+        connections.push_back(conn);
+        connectionProfiles_[conn] = defaultProfile_;
+        session.connection = conn;
+    }
+    if (g_hConnection == old)
+    {
+        g_hConnection = conn != k_HSteamNetConnection_Invalid ? conn : (connections.empty() ? k_HSteamNetConnection_Invalid : connections.front());
+    }
+    g_isConnected = !connections.empty();
+    return conn != k_HSteamNetConnection_Invalid;
+}
+
+HSteamListenSocket SteamNetworkingManager::createListenSocket()
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    const TuningProfile *profile = tuningProfiles_.find(defaultProfile_);
+    std::vector<SteamNetworkingConfigValue_t> options = profile ? profile->options() : std::vector<SteamNetworkingConfigValue_t>();
+    hListenSock = m_pInterface->CreateListenSocketP2P(0, static_cast<int>(options.size()), options.data());
+    listenProfile_ = defaultProfile_;
+    return hListenSock;
+}
+
+std::string SteamNetworkingManager::getDefaultTuningProfile() const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    return defaultProfile_;
+}
+
+bool SteamNetworkingManager::setDefaultTuningProfile(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    if (!tuningProfiles_.find(name))
+    {
+        return false;
+    }
+    defaultProfile_ = name;
+    return true;
+}
+
+bool SteamNetworkingManager::setConnectionTuningProfile(HSteamNetConnection conn, const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    const TuningProfile *profile = tuningProfiles_.find(name);
+    if (!profile || std::find(connections.begin(), connections.end(), conn) == connections.end())
+    {
+        return false;
+    }
+    if (!TuningProfiles::applyToConnection(conn, *profile))
+    {
+        return false;
+    }
+    connectionProfiles_[conn] = name;
+    return true;
+}
+
+std::string SteamNetworkingManager::getConnectionTuningProfile(HSteamNetConnection conn) const
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex);
+    auto it = connectionProfiles_.find(conn);
+    return it != connectionProfiles_.end() ? it->second : std::string();
+}
+
+std::vector<RateControlStats> SteamNetworkingManager::getRateControlStats() const
+{
+    return rateController_ ? rateController_->getStats() : std::vector<RateControlStats>();
+}
+
+bool SteamNetworkingManager::isConnectionReady() const
+{
+    return g_isConnected && isConnectionReady(g_hConnection);
+}
+
+bool SteamNetworkingManager::isConnectionReady(HSteamNetConnection conn) const
+{
+    if (conn == k_HSteamNetConnection_Invalid)
+    {
+        return false;
+    }
+    SteamNetConnectionInfo_t info;
+    return m_pInterface->GetConnectionInfo(conn, &info) && info.m_eState == k_ESteamNetworkingConnectionState_Connected;
 }
 
 int SteamNetworkingManager::getConnectionPing(HSteamNetConnection conn) const
@@ -367,12 +748,32 @@ void SteamNetworkingManager::handleConnectionStatusChanged(SteamNetConnectionSta
     }
     if (pInfo->m_eOldState == k_ESteamNetworkingConnectionState_None && pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_Connecting)
     {
-        std::cout << "[主机] 收到连接请求: " << pInfo->m_info.m_identityRemote.GetSteamID().ConvertToUint64() << "\033[K\n";
         m_lastError.clear(); // Clear error on new connection attempt
-        m_pInterface->AcceptConnection(pInfo->m_hConn);
-        connections.push_back(pInfo->m_hConn);
-        g_hConnection = pInfo->m_hConn;
-        g_isConnected = true;
+        if (pInfo->m_info.m_hListenSocket != k_HSteamListenSocket_Invalid)
+        {
+            std::cout << "[主机] 收到连接请求: " << pInfo->m_info.m_identityRemote.GetSteamID().ConvertToUint64() << "\033[K\n";
+            if (canAdmitPeer())
+            {
+                admitPeer(pInfo->m_hConn);
+            }
+            else
+            {
+                // Leave it in Connecting: accepted if a slot frees up before Steam's initial
+                // connect timeout, otherwise Steam drops it and the peer sees a failed connect
+                unacceptedPeers_.push_back(pInfo->m_hConn);
+                std::cout << "[主机] 房间已满，暂不接受该对端（未接入 " << unacceptedPeers_.size()
+                          << "）：连接超时前有空位才接入，否则对端连接失败\033[K\n";
+            }
+        }
+        else
+        {
+            if (std::find(connections.begin(), connections.end(), pInfo->m_hConn) == connections.end())
+            {
+                connections.push_back(pInfo->m_hConn);
+            }
+            g_hConnection = pInfo->m_hConn;
+            g_isConnected = true;
+        }
     }
     else if (pInfo->m_eOldState == k_ESteamNetworkingConnectionState_Connecting && pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_Connected)
     {
@@ -388,8 +789,14 @@ void SteamNetworkingManager::handleConnectionStatusChanged(SteamNetConnectionSta
     }
     else if (pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer || pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_ProblemDetectedLocally)
     {
-        g_isConnected = false;
-        g_hConnection = k_HSteamNetConnection_Invalid;
+        for (auto &session : hostSessions_)
+        {
+            if (session->connection == pInfo->m_hConn)
+            {
+                session->connection = k_HSteamNetConnection_Invalid;
+            }
+        }
+        releaseConnection(pInfo->m_hConn);
         
         std::stringstream ss;
         if (pInfo->m_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer) {
@@ -417,10 +824,23 @@ void SteamNetworkingManager::handleConnectionStatusChanged(SteamNetConnectionSta
 
         // Remove from connections
         auto it = std::find(connections.begin(), connections.end(), pInfo->m_hConn);
-        if (it != connections.end())
+        bool wasAdmitted = it != connections.end();
+        if (wasAdmitted)
         {
             connections.erase(it);
         }
-        hostPing_ = 0;
+        unacceptedPeers_.erase(std::remove(unacceptedPeers_.begin(), unacceptedPeers_.end(), pInfo->m_hConn), unacceptedPeers_.end());
+        // Other hosts/peers may still be connected
+        if (g_hConnection == pInfo->m_hConn)
+        {
+            g_hConnection = connections.empty() ? k_HSteamNetConnection_Invalid : connections.front();
+            hostPing_ = 0;
+        }
+        g_isConnected = !connections.empty();
+        if (wasAdmitted && g_isHost)
+        {
+            admitUnacceptedPeers();
+            applyBandwidthBudget();
+        }
     }
 }
\ No newline at end of file
@@ -5,15 +5,21 @@
 #include <map>
 #include <mutex>
 #include <memory>
+#include <deque>
+#include <chrono>
 #include <steam_api.h>
 #include <isteamnetworkingsockets.h>
 #include <isteamnetworkingutils.h>
 #include <steamnetworkingtypes.h>
 #include "steam_message_handler.h"
+#include "send_rate_controller.h"
+#include "tuning_profiles.h"
+#include "path_selector.h"
 
 // Forward declarations
 class TCPServer;
 class SteamNetworkingManager;
+class ThreadPlacement;
 
 // User info structure
 struct UserInfo {
@@ -23,15 +29,44 @@ struct UserInfo {
     bool isRelay;
 };
 
+// 主持端准入控制：超出人数或带宽预算的对端暂不 Accept，在 Steam 的初始连接超时（TimeoutInitial，
+// 随调优配置为 10–30 秒）内有空位才接入，否则由 Steam 断开、对端看到连接失败。这不是排队，只是短暂的宽限期。
+struct AdmissionPolicy {
+    int lobbyCapacity = 4;           // Steam 大厅上限 250
+    int maxPeers = 0;                // 0 = 不限
+    int maxStreamsPerPeer = 0;       // 0 = 不限
+    int64 bandwidthBudget = 0;       // 所有对端合计发送速率上限 (bytes/s)，0 = 不限
+    int minPeerRate = 256 * 1024;    // 预算均分后每个对端至少保留的速率，不足则暂不接入
+    int64 memoryBudget = 0;          // 隧道缓冲 + Steam 发送缓冲合计上限 (bytes)，0 = 不限；超出时拒绝新流并暂停读取
+};
+
+static const int kMaxLobbyMembers = 250;
+
+// Client-side view of one host session (status output)
+struct HostSessionInfo {
+    CSteamID hostID;
+    HSteamNetConnection connection;
+    std::vector<int> ports;
+    int clientCount;
+    PendingAcceptStats pending;
+};
+
 class SteamNetworkingManager {
 public:
     static SteamNetworkingManager* instance;
     SteamNetworkingManager();
     ~SteamNetworkingManager();
 
+    // Kick off relay config download and ping measurement; call right after SteamAPI_Init
+    // so they run in the background while the rest of startup proceeds
+    static void prewarmRelayNetwork();
     bool initialize();
     void shutdown();
     void setForceRelay(bool force);
+    void setPathMode(PathMode mode);
+    PathMode getPathMode() const { return pathMode_; }
+    void setPeerPingLocation(CSteamID peer, const std::string& location) { pathSelector_.setRemotePingLocation(peer, location); }
+    std::vector<PathStats> getPathStats() const { return pathSelector_.getStats(); }
     void printRelayStatus();
     void sendPing();
 
@@ -39,10 +74,20 @@ public:
     bool joinHost(uint64 hostID);
     void disconnect();
 
+    // 多主机会话（客户端）：每个主机一条 P2P 连接 + 一组本地监听端口，共用同一个接收循环
+    bool openHostSession(CSteamID hostID, const std::vector<int>& ports);
+    void closeHostSessions();
+    bool hasHostSession(CSteamID hostID) const;
+    size_t getHostSessionCount() const;
+    std::vector<HostSessionInfo> getHostSessions() const;
+    HSteamNetConnection getHostConnection(CSteamID hostID) const;
+
     // Getters
     bool isHost() const { return g_isHost; }
     bool isClient() const { return g_isClient; }
     bool isConnected() const { return g_isConnected; }
+    bool isConnectionReady() const; // current connection has reached Connected
+    bool isConnectionReady(HSteamNetConnection conn) const;
     const std::vector<HSteamNetConnection>& getConnections() const { return connections; }
     int getHostPing() const { return hostPing_; }
     int getConnectionPing(HSteamNetConnection conn) const;
@@ -51,19 +96,39 @@ public:
     std::string getConnectionRelayInfo(HSteamNetConnection conn) const;
 
     // For SteamRoomManager access
-    std::unique_ptr<TCPServer>*& getServer() { return server_; }
-    int*& getLocalPort() { return localPort_; }
+    ForwardTargetList*& getForwardTargets() { return forwardTargets_; }
     boost::asio::io_context*& getIOContext() { return io_context_; }
     HSteamListenSocket& getListenSock() { return hListenSock; }
     ISteamNetworkingSockets* getInterface() { return m_pInterface; }
     bool& getIsHost() { return g_isHost; }
 
-    void setMessageHandlerDependencies(boost::asio::io_context& io_context, std::unique_ptr<TCPServer>& server, int& localPort);
+    void setMessageHandlerDependencies(boost::asio::io_context& io_context, ForwardTargetList& targets);
 
     // Message handler
     void startMessageHandler();
     void stopMessageHandler();
     SteamMessageHandler* getMessageHandler() { return messageHandler_; }
+    // CPU/priority placement applied to the TCP server threads of host sessions
+    void setThreadPlacement(std::shared_ptr<ThreadPlacement> placement) { threadPlacement_ = std::move(placement); }
+    std::shared_ptr<ThreadPlacement> getThreadPlacement() const { return threadPlacement_; }
+    std::vector<RateControlStats> getRateControlStats() const;
+
+    // Host admission control
+    AdmissionPolicy getAdmissionPolicy() const;
+    void setAdmissionPolicy(const AdmissionPolicy& policy);
+    size_t getUnacceptedPeerCount() const;
+    // How long an unaccepted peer lasts before Steam drops it (listen socket's TimeoutInitial), -1 if unknown
+    int getUnacceptedPeerTimeoutMs() const;
+
+    // Network tuning profiles: the default applies to new connections (ConnectP2P options,
+    // or switched on accept when the listen socket was created under another profile);
+    // a live connection can be switched without reconnecting
+    HSteamListenSocket createListenSocket(); // host: P2P listen socket with the default profile's options
+    std::vector<std::string> getTuningProfileNames() const { return tuningProfiles_.names(); }
+    std::string getDefaultTuningProfile() const;
+    bool setDefaultTuningProfile(const std::string& name);
+    bool setConnectionTuningProfile(HSteamNetConnection conn, const std::string& name);
+    std::string getConnectionTuningProfile(HSteamNetConnection conn) const;
 
     // Update user info (ping, relay status)
     void update();
@@ -96,12 +161,44 @@ private:
     int g_retryCount;
     const int MAX_RETRIES = 3;
     int g_currentVirtualPort;
+    std::unique_ptr<SendRateController> rateController_; // per-connection SendRateMin/Max
+
+    // Tuning profiles (guarded by connectionsMutex)
+    TuningProfiles tuningProfiles_;
+    std::string defaultProfile_;
+    std::string listenProfile_; // options the listen socket (and so every incoming connection) started with
+    std::map<HSteamNetConnection, std::string> connectionProfiles_;
+    std::vector<SteamNetworkingConfigValue_t> buildConnectOptions(bool relayOnly) const; // requires connectionsMutex
+
+    // Relay/direct path selection
+    PathMode pathMode_;
+    PathSelector pathSelector_;
+    std::chrono::steady_clock::time_point lastPathSample_;
+
+    // Admission control (guarded by connectionsMutex)
+    AdmissionPolicy admission_;
+    std::deque<HSteamNetConnection> unacceptedPeers_; // left in Connecting, oldest first
+    bool canAdmitPeer() const; // requires connectionsMutex
+    void admitPeer(HSteamNetConnection conn); // requires connectionsMutex
+    void admitUnacceptedPeers(); // requires connectionsMutex
+    void applyBandwidthBudget(); // requires connectionsMutex
+
+    // Client host sessions (guarded by connectionsMutex)
+    struct HostSession {
+        CSteamID hostID;
+        HSteamNetConnection connection;
+        std::unique_ptr<TCPServer> server;
+    };
+    std::vector<std::unique_ptr<HostSession>> hostSessions_;
+    void samplePaths(); // requires connectionsMutex
+    bool reconnectHostSession(HostSession& session, bool relayOnly); // requires connectionsMutex
+    void releaseConnection(HSteamNetConnection conn); // per-connection state of a closed connection; requires connectionsMutex
 
     // Message handler dependencies
     boost::asio::io_context* io_context_;
-    std::unique_ptr<TCPServer>* server_;
-    int* localPort_;
+    ForwardTargetList* forwardTargets_;
     SteamMessageHandler* messageHandler_;
+    std::shared_ptr<ThreadPlacement> threadPlacement_;
 
     // 使用 STEAM_CALLBACK 宏来确保回调正确注册（由 SteamAPI_RunCallbacks() 自动触发）
     STEAM_CALLBACK(SteamNetworkingManager, OnSteamNetConnectionStatusChanged, SteamNetConnectionStatusChangedCallback_t);
@@ -30,6 +30,16 @@ void SteamMatchmakingCallbacks::OnLobbyCreated(LobbyCreated_t *pCallback, bool b
     if (pCallback->m_eResult == k_EResultOK)
     {
         roomManager_->setCurrentLobby(pCallback->m_ulSteamIDLobby);
+
+        // Publish the port mappings so clients open one local listener per service
+        if (manager_->getForwardTargets())
+        {
+            std::string services = ForwardTarget::describeList(*manager_->getForwardTargets()->load());
+            SteamMatchmaking()->SetLobbyData(pCallback->m_ulSteamIDLobby, "services", services.c_str());
+        }
+        // Lets searchers rank us by latency and reuse our cached ping location
+        SteamMatchmaking()->SetLobbyData(pCallback->m_ulSteamIDLobby, "host", std::to_string(SteamUser()->GetSteamID().ConvertToUint64()).c_str());
+        SteamMatchmaking()->SetLobbyData(pCallback->m_ulSteamIDLobby, "host_name", SteamFriends()->GetPersonaName());
         
         // Set Rich Presence to enable invite functionality
         SteamFriends()->SetRichPresence("steam_display", "#Status_InLobby");
@@ -40,11 +50,48 @@ void SteamMatchmakingCallbacks::OnLobbyCreated(LobbyCreated_t *pCallback, bool b
 void SteamMatchmakingCallbacks::OnLobbyListReceived(LobbyMatchList_t *pCallback, bool bIOFailure)
 {
     if (bIOFailure) return;
-    roomManager_->clearLobbies();
+    PingLocationCache &cache = roomManager_->getPingCache();
+    int maxPing = roomManager_->getSearchMaxPing();
+    std::vector<LobbyInfo> found;
     for (uint32 i = 0; i < pCallback->m_nLobbiesMatching; ++i)
     {
         CSteamID lobbyID = SteamMatchmaking()->GetLobbyByIndex(i);
-        roomManager_->addLobby(lobbyID);
+        CSteamID hostID;
+        try
+        {
+            hostID = CSteamID(static_cast<uint64>(std::stoull(SteamMatchmaking()->GetLobbyData(lobbyID, "host"))));
+        }
+        catch (const std::exception &)
+        {
+            // Lobbies from older builds do not publish the host
+        }
+        std::string location = SteamMatchmaking()->GetLobbyData(lobbyID, "pingloc");
+        if (location.empty())
+        {
+            location = cache.hostLocation(hostID);
+        }
+        else
+        {
+            cache.rememberHost(hostID, location);
+        }
+        LobbyInfo info{lobbyID, SteamMatchmaking()->GetLobbyData(lobbyID, "host_name"),
+                       SteamMatchmaking()->GetNumLobbyMembers(lobbyID), SteamMatchmaking()->GetLobbyMemberLimit(lobbyID),
+                       cache.estimatePing(location)};
+        if (maxPing > 0 && info.pingMs > maxPing)
+        {
+            continue;
+        }
+        found.push_back(info);
+    }
+    roomManager_->setLobbies(std::move(found));
+
+    const auto &lobbies = roomManager_->getLobbies();
+    std::cout << "[大厅] 找到 " << lobbies.size() << " 个大厅（按预估延迟排序）：\033[K\n";
+    for (const auto &lobby : lobbies)
+    {
+        std::cout << " - " << lobby.lobby.ConvertToUint64() << "  " << (lobby.hostName.empty() ? "?" : lobby.hostName)
+                  << "  " << lobby.members << "/" << lobby.capacity << "  "
+                  << (lobby.pingMs >= 0 ? "~" + std::to_string(lobby.pingMs) + " ms" : std::string("延迟未知")) << "\033[K\n";
     }
 }
 
@@ -62,28 +109,42 @@ void SteamMatchmakingCallbacks::OnLobbyEntered(LobbyEnter_t *pCallback)
         if (!manager_->isHost())
         {
             CSteamID hostID = SteamMatchmaking()->GetLobbyOwner(pCallback->m_ulSteamIDLobby);
-            if (manager_->joinHost(hostID.ConvertToUint64()))
+            // One listener per host service: base, base+1, ...
+            // Each additional host session gets its own block (8888, 8898, ...) unless 'join' named one
+            int basePort = roomManager_->takeJoinBasePort();
+            if (basePort <= 0)
+            {
+                basePort = 8888 + 10 * static_cast<int>(manager_->getHostSessionCount());
+            }
+            std::string services = SteamMatchmaking()->GetLobbyData(pCallback->m_ulSteamIDLobby, "services");
+            size_t serviceCount = services.empty() ? 1 : std::count(services.begin(), services.end(), ',') + 1;
+            std::vector<int> ports;
+            for (size_t i = 0; i < serviceCount; ++i)
             {
-                // Start TCP Server if dependencies are set
-                if (manager_->getServer() && !(*manager_->getServer()))
-                {
-                    *manager_->getServer() = std::make_unique<TCPServer>(8888, manager_);
-                    if (!(*manager_->getServer())->start())
-                    {
-                        // Failed to start TCP server
-                    }
-                }
+                ports.push_back(basePort + static_cast<int>(i));
             }
+            std::string location = SteamMatchmaking()->GetLobbyData(pCallback->m_ulSteamIDLobby, "pingloc");
+            if (location.empty())
+            {
+                location = roomManager_->getPingCache().hostLocation(hostID);
+            }
+            else
+            {
+                roomManager_->getPingCache().rememberHost(hostID, location);
+            }
+            manager_->setPeerPingLocation(hostID, location);
+            manager_->openHostSession(hostID, ports);
         }
     }
 }
 
 SteamRoomManager::SteamRoomManager(SteamNetworkingManager *networkingManager)
-    : networkingManager_(networkingManager), currentLobby(k_steamIDNil),
-      steamFriendsCallbacks(nullptr), steamMatchmakingCallbacks(nullptr)
+    : networkingManager_(networkingManager), currentLobby(k_steamIDNil), searchMaxPingMs_(0),
+      joinBasePort_(0), pingLocationMeasured_(false), steamFriendsCallbacks(nullptr), steamMatchmakingCallbacks(nullptr)
 {
     steamFriendsCallbacks = new SteamFriendsCallbacks(networkingManager_, this);
     steamMatchmakingCallbacks = new SteamMatchmakingCallbacks(networkingManager_, this);
+    pingCache_.load();
 
     // Clear Rich Presence on initialization to prevent "Invite to game" showing when not in a lobby
     SteamFriends()->ClearRichPresence();
@@ -97,7 +158,8 @@ SteamRoomManager::~SteamRoomManager()
 
 bool SteamRoomManager::createLobby()
 {
-    SteamAPICall_t hSteamAPICall = SteamMatchmaking()->CreateLobby(k_ELobbyTypePublic, 4);
+    int capacity = networkingManager_->getAdmissionPolicy().lobbyCapacity;
+    SteamAPICall_t hSteamAPICall = SteamMatchmaking()->CreateLobby(k_ELobbyTypePublic, capacity);
     if (hSteamAPICall == k_uAPICallInvalid)
     {
         return false;
@@ -107,21 +169,74 @@ bool SteamRoomManager::createLobby()
     return true;
 }
 
+void SteamRoomManager::update()
+{
+    if (pingLocationMeasured_ || currentLobby == k_steamIDNil || !networkingManager_->isHost())
+    {
+        return;
+    }
+    // Clients estimate the relay route to us from this (path selection). The disk cache may be
+    // stale (another network since the last run), so it is replaced once Steam has measured.
+    SteamNetworkPingLocation_t location;
+    bool measured = false;
+    if (!pingCache_.localLocation(location, &measured))
+    {
+        return; // Relay pings not measured yet and nothing cached
+    }
+    char text[k_cchMaxSteamNetworkingPingLocationString];
+    SteamNetworkingUtils()->ConvertPingLocationToString(location, text, sizeof(text));
+    if (publishedPingLocation_ != text)
+    {
+        if (!SteamMatchmaking()->SetLobbyData(currentLobby, "pingloc", text))
+        {
+            return;
+        }
+        publishedPingLocation_ = text;
+    }
+    pingLocationMeasured_ = measured;
+}
+
+bool SteamRoomManager::applyLobbyCapacity()
+{
+    if (currentLobby == k_steamIDNil || !networkingManager_->isHost())
+    {
+        return false;
+    }
+    return SteamMatchmaking()->SetLobbyMemberLimit(currentLobby, networkingManager_->getAdmissionPolicy().lobbyCapacity);
+}
+
 void SteamRoomManager::leaveLobby()
 {
     if (currentLobby != k_steamIDNil)
     {
         SteamMatchmaking()->LeaveLobby(currentLobby);
         currentLobby = k_steamIDNil;
+        publishedPingLocation_.clear();
+        pingLocationMeasured_ = false;
         
         // Clear Rich Presence when leaving lobby
         SteamFriends()->ClearRichPresence();
     }
 }
 
-bool SteamRoomManager::searchLobbies()
+void SteamRoomManager::setLobbies(std::vector<LobbyInfo> found)
+{
+    // Known pings first, closest first
+    std::stable_sort(found.begin(), found.end(), [](const LobbyInfo &a, const LobbyInfo &b) {
+        if ((a.pingMs < 0) != (b.pingMs < 0))
+        {
+            return a.pingMs >= 0;
+        }
+        return a.pingMs < b.pingMs;
+    });
+    lobbies = std::move(found);
+}
+
+bool SteamRoomManager::searchLobbies(ELobbyDistanceFilter distance, int maxPingMs)
 {
     lobbies.clear();
+    searchMaxPingMs_ = maxPingMs;
+    SteamMatchmaking()->AddRequestLobbyListDistanceFilter(distance);
     SteamAPICall_t hSteamAPICall = SteamMatchmaking()->RequestLobbyList();
     if (hSteamAPICall == k_uAPICallInvalid)
     {
@@ -132,8 +247,9 @@ bool SteamRoomManager::searchLobbies()
     return true;
 }
 
-bool SteamRoomManager::joinLobby(CSteamID lobbyID)
+bool SteamRoomManager::joinLobby(CSteamID lobbyID, int basePort)
 {
+    joinBasePort_ = basePort;
     SteamAPICall_t hSteamAPICall = SteamMatchmaking()->JoinLobby(lobbyID);
     if (hSteamAPICall == k_uAPICallInvalid)
     {
@@ -150,9 +266,7 @@ bool SteamRoomManager::startHosting()
         return false;
     }
 
-    networkingManager_->getListenSock() = networkingManager_->getInterface()->CreateListenSocketP2P(0, 0, nullptr);
-
-    if (networkingManager_->getListenSock() != k_HSteamListenSocket_Invalid)
+    if (networkingManager_->createListenSocket() != k_HSteamListenSocket_Invalid)
     {
         networkingManager_->getIsHost() = true;
         return true;
@@ -3,6 +3,18 @@
 #include <vector>
 #include <iostream>
 #include <mutex>
+#include <string>
+#include "ping_location_cache.h"
+
+// One search result, ranked by predicted round trip to its host
+struct LobbyInfo
+{
+    CSteamID lobby;
+    std::string hostName;
+    int members;
+    int capacity;
+    int pingMs; // -1 = host did not publish a ping location
+};
 
 class SteamNetworkingManager; // Forward declaration
 class SteamRoomManager; // Forward declaration for callbacks
@@ -45,23 +57,33 @@ public:
 
     bool createLobby();
     void leaveLobby();
-    bool searchLobbies();
-    bool joinLobby(CSteamID lobbyID);
+    // maxPingMs > 0 drops lobbies predicted to be slower; unknown pings are kept at the end
+    bool searchLobbies(ELobbyDistanceFilter distance = k_ELobbyDistanceFilterDefault, int maxPingMs = 0);
+    bool joinLobby(CSteamID lobbyID, int basePort = 0); // basePort: first local listener port, 0 = auto
     bool startHosting();
     void stopHosting();
+    bool applyLobbyCapacity(); // push the admission policy's capacity to the current lobby
+    void update(); // main loop: publishes the host's ping location, again once it is measured
 
     CSteamID getCurrentLobby() const { return currentLobby; }
-    const std::vector<CSteamID>& getLobbies() const { return lobbies; }
+    const std::vector<LobbyInfo>& getLobbies() const { return lobbies; }
     std::vector<CSteamID> getLobbyMembers() const;
 
     void setCurrentLobby(CSteamID lobby) { currentLobby = lobby; }
-    void addLobby(CSteamID lobby) { lobbies.push_back(lobby); }
-    void clearLobbies() { lobbies.clear(); }
+    void setLobbies(std::vector<LobbyInfo> found);
+    int getSearchMaxPing() const { return searchMaxPingMs_; }
+    PingLocationCache& getPingCache() { return pingCache_; }
+    int takeJoinBasePort() { int port = joinBasePort_; joinBasePort_ = 0; return port; }
 
 private:
     SteamNetworkingManager *networkingManager_;
     CSteamID currentLobby;
-    std::vector<CSteamID> lobbies;
+    std::vector<LobbyInfo> lobbies;
+    int searchMaxPingMs_;
+    PingLocationCache pingCache_;
+    int joinBasePort_;
+    std::string publishedPingLocation_; // empty = nothing published in the current lobby
+    bool pingLocationMeasured_;         // the published location came from a live measurement
     SteamFriendsCallbacks *steamFriendsCallbacks;
     SteamMatchmakingCallbacks *steamMatchmakingCallbacks;
 };
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "tuning_profiles.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <isteamnetworkingutils.h>
+
+const char *const TuningProfiles::kDefaultFile = "tuning_profiles.ini";
+
+namespace
+{
+struct KeyName
+{
+    const char *name;
+    ESteamNetworkingConfigValue value;
+};
+
+const KeyName kKeys[] = {
+    {"NagleTime", k_ESteamNetworkingConfig_NagleTime},
+    {"SendBufferSize", k_ESteamNetworkingConfig_SendBufferSize},
+    {"RecvBufferSize", k_ESteamNetworkingConfig_RecvBufferSize},
+    {"RecvBufferMessages", k_ESteamNetworkingConfig_RecvBufferMessages},
+    {"MTU_PacketSize", k_ESteamNetworkingConfig_MTU_PacketSize},
+    {"TimeoutInitial", k_ESteamNetworkingConfig_TimeoutInitial},
+    {"TimeoutConnected", k_ESteamNetworkingConfig_TimeoutConnected},
+};
+
+std::string trim(const std::string &text)
+{
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+}
+
+std::vector<SteamNetworkingConfigValue_t> TuningProfile::options() const
+{
+    std::vector<SteamNetworkingConfigValue_t> result(values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        result[i].SetInt32(values[i].first, values[i].second);
+    }
+    return result;
+}
+
+TuningProfiles::TuningProfiles()
+    : defaultName_("lowlatency")
+{
+    // lowlatency matches the settings this tool always used
+    profiles_.push_back({"lowlatency", {
+        {k_ESteamNetworkingConfig_NagleTime, 0},
+        {k_ESteamNetworkingConfig_SendBufferSize, 10 * 1024 * 1024},
+        {k_ESteamNetworkingConfig_MTU_PacketSize, 1200},
+        {k_ESteamNetworkingConfig_TimeoutInitial, 30000},
+        {k_ESteamNetworkingConfig_TimeoutConnected, 30000},
+    }});
+    // bulk: let Nagle coalesce small writes and keep a deeper send buffer for large transfers
+    profiles_.push_back({"bulk", {
+        {k_ESteamNetworkingConfig_NagleTime, 5000},
+        {k_ESteamNetworkingConfig_SendBufferSize, 32 * 1024 * 1024},
+        {k_ESteamNetworkingConfig_MTU_PacketSize, 1200},
+        {k_ESteamNetworkingConfig_TimeoutInitial, 30000},
+        {k_ESteamNetworkingConfig_TimeoutConnected, 30000},
+    }});
+    // lan: full-size packets and fast failure detection
+    profiles_.push_back({"lan", {
+        {k_ESteamNetworkingConfig_NagleTime, 0},
+        {k_ESteamNetworkingConfig_SendBufferSize, 10 * 1024 * 1024},
+        {k_ESteamNetworkingConfig_MTU_PacketSize, 1300},
+        {k_ESteamNetworkingConfig_TimeoutInitial, 10000},
+        {k_ESteamNetworkingConfig_TimeoutConnected, 10000},
+    }});
+}
+
+bool TuningProfiles::parseKey(const std::string &key, ESteamNetworkingConfigValue &value)
+{
+    for (const auto &entry : kKeys)
+    {
+        if (key == entry.name)
+        {
+            value = entry.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+TuningProfile &TuningProfiles::getOrAdd(const std::string &name)
+{
+    for (auto &profile : profiles_)
+    {
+        if (profile.name == name)
+        {
+            return profile;
+        }
+    }
+    profiles_.push_back({name, {}});
+    return profiles_.back();
+}
+
+bool TuningProfiles::loadFile(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        return false;
+    }
+    std::string section;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        line = trim(line.substr(0, line.find_first_of("#;")));
+        if (line.empty())
+        {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']')
+        {
+            section = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+        size_t eq = line.find('=');
+        std::string key = eq == std::string::npos ? "" : trim(line.substr(0, eq));
+        std::string text = eq == std::string::npos ? "" : trim(line.substr(eq + 1));
+        if (section.empty() && key == "default")
+        {
+            defaultName_ = text;
+            continue;
+        }
+        ESteamNetworkingConfigValue value = k_ESteamNetworkingConfig_Invalid;
+        int32 number = 0;
+        bool valid = !section.empty() && parseKey(key, value);
+        if (valid)
+        {
+            try
+            {
+                number = std::stoi(text);
+            }
+            catch (const std::exception &)
+            {
+                valid = false;
+            }
+        }
+        if (!valid)
+        {
+            std::cerr << "[配置] " << path << ":" << lineNumber << " 无法识别：" << line << std::endl;
+            continue;
+        }
+        TuningProfile &profile = getOrAdd(section);
+        auto it = std::find_if(profile.values.begin(), profile.values.end(),
+                               [value](const std::pair<ESteamNetworkingConfigValue, int32> &entry) { return entry.first == value; });
+        if (it != profile.values.end())
+        {
+            it->second = number;
+        }
+        else
+        {
+            profile.values.emplace_back(value, number);
+        }
+    }
+    if (!find(defaultName_))
+    {
+        std::cerr << "[配置] 默认调优配置 '" << defaultName_ << "' 不存在，改用 lowlatency" << std::endl;
+        defaultName_ = "lowlatency";
+    }
+    std::cout << "[配置] 已加载网络调优配置 " << path << "，默认：" << defaultName_ << std::endl;
+    return true;
+}
+
+const TuningProfile *TuningProfiles::find(const std::string &name) const
+{
+    for (const auto &profile : profiles_)
+    {
+        if (profile.name == name)
+        {
+            return &profile;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<std::string> TuningProfiles::names() const
+{
+    std::vector<std::string> result;
+    for (const auto &profile : profiles_)
+    {
+        result.push_back(profile.name);
+    }
+    return result;
+}
+
+bool TuningProfiles::applyToConnection(HSteamNetConnection conn, const TuningProfile &profile)
+{
+    bool ok = true;
+    for (const auto &entry : profile.values)
+    {
+        ok = SteamNetworkingUtils()->SetConnectionConfigValueInt32(conn, entry.first, entry.second) && ok;
+    }
+    return ok;
+}
+
+void TuningProfiles::applyGlobal(const TuningProfile &profile)
+{
+    for (const auto &entry : profile.values)
+    {
+        SteamNetworkingUtils()->SetGlobalConfigValueInt32(entry.first, entry.second);
+    }
+}
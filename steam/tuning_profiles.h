@@ -0,0 +1,54 @@
+#ifndef TUNING_PROFILES_H
+#define TUNING_PROFILES_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <steam_api.h>
+#include <isteamnetworkingsockets.h>
+#include <steamnetworkingtypes.h>
+
+// One named set of per-connection Steam networking options
+struct TuningProfile
+{
+    std::string name;
+    std::vector<std::pair<ESteamNetworkingConfigValue, int32>> values;
+
+    // Option array for ConnectP2P / CreateListenSocketP2P
+    std::vector<SteamNetworkingConfigValue_t> options() const;
+};
+
+// 网络调优配置：内置 lowlatency / bulk / lan 三套，可由 tuning_profiles.ini 覆盖或新增。
+// 文件格式：
+//   default = lowlatency
+//   [bulk]
+//   NagleTime = 5000
+//   SendBufferSize = 33554432
+// 发送速率不在这里配置，由 SendRateController 按连接自适应。
+class TuningProfiles
+{
+public:
+    static const char *const kDefaultFile;
+
+    TuningProfiles();
+
+    // Missing file is not an error (built-ins stay); malformed lines are reported and skipped
+    bool loadFile(const std::string &path);
+
+    const TuningProfile *find(const std::string &name) const;
+    std::vector<std::string> names() const;
+    const std::string &defaultName() const { return defaultName_; }
+
+    // Live switch: writes every value of the profile onto an existing connection
+    static bool applyToConnection(HSteamNetConnection conn, const TuningProfile &profile);
+    static void applyGlobal(const TuningProfile &profile);
+
+private:
+    static bool parseKey(const std::string &key, ESteamNetworkingConfigValue &value);
+    TuningProfile &getOrAdd(const std::string &name);
+
+    std::vector<TuningProfile> profiles_;
+    std::string defaultName_;
+};
+
+#endif // TUNING_PROFILES_H
@@ -0,0 +1,363 @@
+// capture_replay：把 `capture start` 录下的隧道流量重新打到隧道入口，对比回放与录制时的时延和吞吐。
+//
+//   capture_replay <捕获文件> <目标> [倍速]   目标为客户端本地监听端口（如 127.0.0.1:25565），倍速默认 1
+//   capture_replay --info <捕获文件>          只打印捕获内容概要
+//
+// 每个录到打开事件的流都会在录制时刻（除以倍速）建立一个本地连接，按录制时刻发送发起方的数据
+// （捕获了内容则原样发送，否则补零），并读取另一方向的数据。主机端和客户端的捕获都可以回放：
+// 流由哪一端打开，哪一端的数据就是要发送的请求。
+#include "net/traffic_capture.h"
+#include "net/forward_target.h"
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Chunk
+{
+    uint64_t timeUs;
+    uint32_t size;
+    const std::vector<char> *payload; // empty: send zeros
+};
+
+struct Expected
+{
+    uint64_t cumulative; // bytes received once this chunk is complete
+    uint64_t timeUs;
+};
+
+struct Report
+{
+    uint64_t sentBytes = 0;
+    uint64_t receivedBytes = 0;
+    uint64_t recordedSent = 0;
+    uint64_t recordedReceived = 0;
+    std::vector<double> sendLatenessMs;
+    std::vector<double> receiveDelayMs; // replay arrival minus recorded arrival (scaled)
+    Clock::time_point lastActivity;
+    int streams = 0;
+    int failedConnects = 0;
+    int resets = 0;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(values.size() * p));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+class ReplayStream : public std::enable_shared_from_this<ReplayStream>
+{
+public:
+    ReplayStream(boost::asio::io_context &io_context, Report &report, Clock::time_point origin, double speed)
+        : socket_(io_context), timer_(io_context), report_(report), origin_(origin), speed_(speed),
+          openUs_(0), closeUs_(0), hasClose_(false), received_(0), nextExpected_(0), readBuffer_(64 * 1024)
+    {
+    }
+
+    std::deque<Chunk> sends;
+    std::vector<Expected> expected;
+
+    void setOpen(uint64_t timeUs) { openUs_ = timeUs; }
+    void setClose(uint64_t timeUs)
+    {
+        closeUs_ = timeUs;
+        hasClose_ = true;
+    }
+
+    void start(const ForwardTarget::Endpoints &endpoints)
+    {
+        auto self = shared_from_this();
+        timer_.expires_at(due(openUs_));
+        timer_.async_wait([self, endpoints](const boost::system::error_code &)
+        {
+            boost::asio::async_connect(self->socket_, endpoints, [self](const boost::system::error_code &ec,
+                                                                        const boost::asio::generic::stream_protocol::endpoint &)
+            {
+                if (ec)
+                {
+                    ++self->report_.failedConnects;
+                    return;
+                }
+                setNoDelay(self->socket_);
+                self->read();
+                self->sendNext();
+            });
+        });
+    }
+
+private:
+    Clock::time_point due(uint64_t timeUs) const
+    {
+        return origin_ + std::chrono::microseconds(static_cast<int64_t>(timeUs / speed_));
+    }
+
+    static double msSince(Clock::time_point since, Clock::time_point now)
+    {
+        return std::chrono::duration<double, std::milli>(now - since).count();
+    }
+
+    void sendNext()
+    {
+        if (sends.empty())
+        {
+            if (hasClose_)
+            {
+                // Half-close at the recorded time; keep reading what the service still sends
+                auto self = shared_from_this();
+                timer_.expires_at(due(closeUs_));
+                timer_.async_wait([self](const boost::system::error_code &ec)
+                {
+                    if (ec)
+                    {
+                        return;
+                    }
+                    boost::system::error_code ignored;
+                    self->socket_.shutdown(StreamSocket::shutdown_send, ignored);
+                });
+            }
+            return;
+        }
+        auto self = shared_from_this();
+        timer_.expires_at(due(sends.front().timeUs));
+        timer_.async_wait([self](const boost::system::error_code &ec)
+        {
+            if (ec)
+            {
+                return; // Service closed the connection
+            }
+            const Chunk &chunk = self->sends.front();
+            self->report_.sendLatenessMs.push_back(std::max(0.0, msSince(self->due(chunk.timeUs), Clock::now())));
+            if (chunk.payload && chunk.payload->size() == chunk.size)
+            {
+                self->writeBuffer_ = *chunk.payload;
+            }
+            else
+            {
+                self->writeBuffer_.assign(chunk.size, 0);
+            }
+            boost::asio::async_write(self->socket_, boost::asio::buffer(self->writeBuffer_),
+                                     [self](const boost::system::error_code &ec, std::size_t n)
+            {
+                if (ec)
+                {
+                    ++self->report_.resets;
+                    return;
+                }
+                self->report_.sentBytes += n;
+                self->report_.lastActivity = Clock::now();
+                self->sends.pop_front();
+                self->sendNext();
+            });
+        });
+    }
+
+    void read()
+    {
+        auto self = shared_from_this();
+        socket_.async_read_some(boost::asio::buffer(readBuffer_), [self](const boost::system::error_code &ec, std::size_t n)
+        {
+            if (ec)
+            {
+                if (ec != boost::asio::error::eof)
+                {
+                    ++self->report_.resets;
+                }
+                self->timer_.cancel();
+                return;
+            }
+            auto now = Clock::now();
+            self->received_ += n;
+            self->report_.receivedBytes += n;
+            self->report_.lastActivity = now;
+            while (self->nextExpected_ < self->expected.size() && self->expected[self->nextExpected_].cumulative <= self->received_)
+            {
+                self->report_.receiveDelayMs.push_back(msSince(self->due(self->expected[self->nextExpected_].timeUs), now));
+                ++self->nextExpected_;
+            }
+            self->read();
+        });
+    }
+
+    StreamSocket socket_;
+    boost::asio::steady_timer timer_;
+    Report &report_;
+    Clock::time_point origin_;
+    double speed_;
+    uint64_t openUs_;
+    uint64_t closeUs_;
+    bool hasClose_;
+    uint64_t received_;
+    size_t nextExpected_;
+    std::vector<char> readBuffer_;
+    std::vector<char> writeBuffer_;
+};
+
+void printInfo(const std::vector<CaptureRecord> &records)
+{
+    std::map<std::string, int> streams;
+    uint64_t bytes[2] = {0, 0};
+    uint64_t payloadBytes = 0;
+    for (const auto &record : records)
+    {
+        if (record.type == CaptureRecord::Open)
+        {
+            ++streams[record.stream];
+        }
+        else if (record.type == CaptureRecord::Data)
+        {
+            bytes[record.direction] += record.size;
+            payloadBytes += record.payload.size();
+        }
+    }
+    double seconds = records.empty() ? 0.0 : (records.back().timeUs - records.front().timeUs) / 1e6;
+    printf("记录 %zu 条 | 时长 %.2f s | 流 %zu | 发出 %.2f MB | 收到 %.2f MB | 内容 %.2f MB\n",
+           records.size(), seconds, streams.size(), bytes[CaptureRecord::Outbound] / (1024.0 * 1024.0),
+           bytes[CaptureRecord::Inbound] / (1024.0 * 1024.0), payloadBytes / (1024.0 * 1024.0));
+}
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && std::string(argv[1]) == "--info")
+    {
+        std::vector<CaptureRecord> records;
+        std::string error;
+        if (!TrafficCapture::load(argv[2], records, error))
+        {
+            std::cerr << argv[2] << ": " << error << std::endl;
+            return 1;
+        }
+        printInfo(records);
+        return 0;
+    }
+    if (argc < 3 || argc > 4)
+    {
+        std::cerr << "用法：capture_replay <捕获文件> <目标> [倍速]\n      capture_replay --info <捕获文件>" << std::endl;
+        return 2;
+    }
+    double speed = argc == 4 ? std::atof(argv[3]) : 1.0;
+    ForwardTarget target;
+    if (speed <= 0.0 || !ForwardTarget::parse(argv[2], target))
+    {
+        std::cerr << "无效的目标或倍速" << std::endl;
+        return 2;
+    }
+    std::vector<CaptureRecord> records;
+    std::string error;
+    if (!TrafficCapture::load(argv[1], records, error))
+    {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return 1;
+    }
+    if (records.empty())
+    {
+        std::cerr << "捕获为空" << std::endl;
+        return 1;
+    }
+    printInfo(records);
+
+    boost::asio::io_context io_context;
+    ForwardTarget::Endpoints endpoints;
+    try
+    {
+        endpoints = target.resolve(io_context);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "无法解析 " << target.toString() << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    Report report;
+    uint64_t firstUs = records.front().timeUs;
+    Clock::time_point origin = Clock::now() + std::chrono::milliseconds(100);
+    report.lastActivity = origin;
+    std::map<std::string, std::pair<std::shared_ptr<ReplayStream>, CaptureRecord::Direction>> streams;
+    std::map<std::string, uint64_t> expectedBytes;
+    int skipped = 0;
+    for (const auto &record : records)
+    {
+        uint64_t timeUs = record.timeUs - firstUs;
+        auto it = streams.find(record.stream);
+        if (record.type == CaptureRecord::Open)
+        {
+            // A reused id starts over; the old stream keeps what it already has
+            auto stream = std::make_shared<ReplayStream>(io_context, report, origin, speed);
+            stream->setOpen(timeUs);
+            streams[record.stream] = std::make_pair(stream, record.direction);
+            expectedBytes[record.stream] = 0;
+            ++report.streams;
+            continue;
+        }
+        if (it == streams.end())
+        {
+            skipped += record.type == CaptureRecord::Data; // Opened before the capture started
+            continue;
+        }
+        ReplayStream &stream = *it->second.first;
+        if (record.type == CaptureRecord::Close)
+        {
+            stream.setClose(timeUs);
+        }
+        else if (record.direction == it->second.second)
+        {
+            // Same direction as the open: the opener's requests, which we send
+            stream.sends.push_back(Chunk{timeUs, record.size, &record.payload});
+            report.recordedSent += record.size;
+        }
+        else
+        {
+            expectedBytes[record.stream] += record.size;
+            stream.expected.push_back(Expected{expectedBytes[record.stream], timeUs});
+            report.recordedReceived += record.size;
+        }
+    }
+    for (auto &pair : streams)
+    {
+        pair.second.first->start(endpoints);
+    }
+    streams.clear(); // Streams live as long as their pending operations
+
+    // Services may hold connections open: give the replay as long again as the recording, at least 5 s
+    double recorded = (records.back().timeUs - firstUs) / 1e6 / speed;
+    auto grace = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(recorded, 5.0)));
+    io_context.run_until(origin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(recorded)) + grace);
+    double elapsed = std::chrono::duration<double>(report.lastActivity - origin).count();
+
+    printf("回放 %d 个流（倍速 %.2f）%s", report.streams, speed, skipped ? "" : "\n");
+    if (skipped)
+    {
+        printf("，跳过 %d 条捕获前已打开流的数据\n", skipped);
+    }
+    if (report.failedConnects || report.resets)
+    {
+        printf("连接失败 %d | 异常中断 %d\n", report.failedConnects, report.resets);
+    }
+    printf("发送：%.2f / %.2f MB | 收到：%.2f / %.2f MB（回放 / 录制）\n",
+           report.sentBytes / (1024.0 * 1024.0), report.recordedSent / (1024.0 * 1024.0),
+           report.receivedBytes / (1024.0 * 1024.0), report.recordedReceived / (1024.0 * 1024.0));
+    printf("耗时：%.2f s，录制按倍速折算 %.2f s | 吞吐：%.2f MB/s，录制 %.2f MB/s\n", elapsed, recorded,
+           (report.sentBytes + report.receivedBytes) / (1024.0 * 1024.0) / std::max(elapsed, 1e-3),
+           (report.recordedSent + report.recordedReceived) / (1024.0 * 1024.0) / std::max(recorded, 1e-3));
+    printf("发送滞后：p50 %.1f ms | p95 %.1f ms | 最大 %.1f ms\n", percentile(report.sendLatenessMs, 0.5),
+           percentile(report.sendLatenessMs, 0.95), percentile(report.sendLatenessMs, 1.0));
+    // Positive: the response arrived later than it did in the recording
+    printf("响应时延（相对录制）：p50 %+.1f ms | p95 %+.1f ms | 最大 %+.1f ms（%zu 个数据块）\n",
+           percentile(report.receiveDelayMs, 0.5), percentile(report.receiveDelayMs, 0.95),
+           percentile(report.receiveDelayMs, 1.0), report.receiveDelayMs.size());
+    return report.failedConnects > 0 ? 1 : 0;
+}